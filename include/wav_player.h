@@ -2,6 +2,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include "esp_err.h"
 
 /**
@@ -15,6 +16,38 @@ typedef struct {
     uint16_t block_align;       /**< Block alignment (channels * bits_per_sample / 8) */
 } wav_header_t;
 
+/** Maximum number of chunks recorded in wav_player_info_t */
+#define WAV_PLAYER_MAX_CHUNKS 8
+
+/** WAVE format tags */
+#define WAV_FORMAT_PCM          0x0001
+#define WAV_FORMAT_EXTENSIBLE   0xFFFE
+
+/**
+ * @brief Location of a RIFF chunk within a WAV file
+ */
+typedef struct {
+    char id[4];                 /**< Chunk identifier, e.g. "fmt ", "data", "LIST" */
+    uint32_t offset;            /**< Offset of the chunk body in the file */
+    uint32_t size;              /**< Size of the chunk body in bytes */
+} wav_chunk_info_t;
+
+/**
+ * @brief Complete WAV file information
+ * 
+ * Filled by wav_player_get_info_ex() and accepted by wav_player_play_info(),
+ * so a file parsed once can be played without parsing it again.
+ */
+typedef struct {
+    wav_header_t header;        /**< Audio format information */
+    uint16_t format_tag;        /**< Format tag, extensible files report their sub-format */
+    uint32_t data_offset;       /**< Offset of the PCM data in the file */
+    uint32_t frame_count;       /**< Number of audio frames */
+    uint32_t duration_ms;       /**< Playback duration in milliseconds */
+    uint8_t chunk_count;        /**< Number of entries in chunks */
+    wav_chunk_info_t chunks[WAV_PLAYER_MAX_CHUNKS]; /**< Chunks in file order (first WAV_PLAYER_MAX_CHUNKS) */
+} wav_player_info_t;
+
 // Volume control
 #define MIN_VOLUME 0
 #define MAX_VOLUME 100
@@ -29,6 +62,49 @@ typedef struct {
  */
 typedef esp_err_t (*wav_player_write_cb_t)(const void* src, size_t size, void* user_data);
 
+/** Maximum number of blocks passed to a vectored write callback at once */
+#define WAV_PLAYER_WRITEV_MAX_BLOCKS 16
+
+/**
+ * @brief A contiguous region of converted audio data
+ */
+typedef struct {
+    const void* data;           /**< Start of the region */
+    size_t size;                /**< Size of the region in bytes */
+} wav_player_iovec_t;
+
+/**
+ * @brief Callback function type for writing several regions of audio data at once
+ * 
+ * The regions are to be played in order. Blocks that are adjacent in memory
+ * are merged into one region, so a batch usually arrives as one region or
+ * as two when it wraps around the end of an internal ring of blocks.
+ * 
+ * @param iov Regions of audio data
+ * @param iovcnt Number of regions
+ * @param user_data User-provided context data
+ * @return ESP_OK on success, ESP_FAIL on failure
+ */
+typedef esp_err_t (*wav_player_writev_cb_t)(const wav_player_iovec_t* iov, size_t iovcnt, void* user_data);
+
+/**
+ * @brief Callback function type for sinks that may accept only part of the data
+ * 
+ * The callback takes as many bytes as fit without blocking and reports the
+ * count; the player keeps the rest and passes it again. This suits a
+ * non-blocking write such as i2s_channel_write() with a timeout of 0.
+ * 
+ * @param src Pointer to source audio data buffer
+ * @param size Size of the audio data in bytes
+ * @param[out] bytes_written Bytes accepted, may be less than size
+ * @param user_data User-provided context data
+ * @return ESP_OK if bytes_written bytes were accepted
+ *         ESP_ERR_TIMEOUT if the sink would block, after accepting bytes_written bytes
+ *         Any other error aborts playback
+ */
+typedef esp_err_t (*wav_player_write_partial_cb_t)(const void* src, size_t size, size_t* bytes_written,
+                                                   void* user_data);
+
 /**
  * @brief Play a WAV file using the provided write callback
  * 
@@ -40,22 +116,220 @@ typedef esp_err_t (*wav_player_write_cb_t)(const void* src, size_t size, void* u
  * @param user_data User data that will be passed to the callback
  * @return ESP_OK on successful playback
  *         ESP_ERR_INVALID_ARG if write_cb is NULL
- *         ESP_FAIL if file cannot be opened or has invalid format
+ *         ESP_FAIL if file cannot be opened or has invalid format, or the data ends early on a read error
  */
 esp_err_t wav_player_play_file(const char* filepath, wav_player_write_cb_t write_cb, void* user_data);
 
+/**
+ * @brief Play a WAV file, handing several blocks to each callback
+ * 
+ * Like wav_player_play_file(), but up to max_blocks converted blocks are
+ * passed to writev_cb in a single call, cutting the number of calls (and
+ * the task handoffs or DMA submissions behind them) by that factor. With
+ * pipelined playback all blocks already converted are passed, so a call
+ * never waits for a batch to fill; serial playback converts max_blocks
+ * blocks before each call.
+ * 
+ * @param filepath Path to the WAV file to play
+ * @param writev_cb Callback function that will receive the audio data
+ * @param max_blocks Maximum number of blocks per call, 1 to WAV_PLAYER_WRITEV_MAX_BLOCKS
+ * @param user_data User data that will be passed to the callback
+ * @return ESP_OK on successful playback
+ *         ESP_ERR_INVALID_ARG if writev_cb is NULL or max_blocks is out of range
+ *         ESP_FAIL if file cannot be opened or has invalid format, or the data ends early on a read error
+ */
+esp_err_t wav_player_play_file_vectored(const char* filepath, wav_player_writev_cb_t writev_cb,
+                                        size_t max_blocks, void* user_data);
+
+/**
+ * @brief Play a WAV file through a sink that may accept partial writes
+ * 
+ * Like wav_player_play_file(), but write_cb may take only part of a block
+ * or report that it would block. The player retries with the remainder;
+ * when nothing was accepted it first sleeps for half the playing time of
+ * the remainder (at least 1 ms), so the sink drains meanwhile instead of
+ * being polled.
+ * 
+ * @param filepath Path to the WAV file to play
+ * @param write_cb Callback function that will receive the audio data
+ * @param user_data User data that will be passed to the callback
+ * @return ESP_OK on successful playback
+ *         ESP_ERR_INVALID_ARG if write_cb is NULL
+ *         ESP_FAIL if file cannot be opened or has invalid format, or the data ends early on a read error
+ *         Error returned by write_cb other than ESP_ERR_TIMEOUT otherwise
+ */
+esp_err_t wav_player_play_file_partial(const char* filepath, wav_player_write_partial_cb_t write_cb,
+                                       void* user_data);
+
+/**
+ * @brief Play a WAV file using information from wav_player_get_info_ex()
+ * 
+ * Seeks straight to the PCM data described by info instead of parsing the
+ * header again. The file must not have changed since info was read.
+ * 
+ * @param filepath Path to the WAV file
+ * @param info File information returned by wav_player_get_info_ex()
+ * @param write_cb Callback function that will receive the audio data
+ * @param user_data User data that will be passed to the callback
+ * @return ESP_OK on successful playback
+ *         ESP_ERR_INVALID_ARG if an argument is NULL or info has an unsupported format
+ *         ESP_FAIL if file cannot be opened
+ */
+esp_err_t wav_player_play_info(const char* filepath, const wav_player_info_t* info,
+                               wav_player_write_cb_t write_cb, void* user_data);
+
+/**
+ * @brief Handle of a WAV file opened for pull-mode playback
+ */
+typedef struct wav_player_handle* wav_player_handle_t;
+
+/**
+ * @brief Open a WAV file for pull-mode playback
+ * 
+ * Instead of pushing blocks into a write callback, the consumer (typically
+ * the task feeding I2S) pulls converted audio with wav_player_read() when it
+ * needs it, so no separate playback task or blocking handoff is required.
+ * Volume, effects, the read scheduler, prefetch and the handle pool apply
+ * as for wav_player_play_file().
+ * 
+ * @param filepath Path to the WAV file
+ * @param[out] handle Receives the player handle
+ * @return ESP_OK on success
+ *         ESP_ERR_INVALID_ARG if an argument is NULL
+ *         ESP_ERR_NO_MEM if the handle cannot be allocated
+ *         ESP_FAIL if file cannot be opened or has invalid format
+ */
+esp_err_t wav_player_open(const char* filepath, wav_player_handle_t* handle);
+
+/**
+ * @brief Read converted audio from a player handle
+ * 
+ * Fills out with up to frames frames of interleaved 16-bit stereo, the same
+ * format wav_player_play_file() passes to its write callback. Fewer frames
+ * are returned only at the end of the file.
+ * 
+ * @param handle Player handle
+ * @param out Output buffer, must hold frames * 2 samples
+ * @param frames Number of frames requested
+ * @param[out] frames_read Number of frames stored, 0 at the end of the file
+ * @return ESP_OK on success
+ *         ESP_ERR_INVALID_ARG if an argument is NULL
+ *         ESP_ERR_INVALID_STATE if wav_player_step_partial() left a frame partly written
+ *         ESP_FAIL if the data ended early on a read error or corrupt data,
+ *         frames_read still counts the frames stored before it
+ */
+esp_err_t wav_player_read(wav_player_handle_t handle, int16_t* out, size_t frames, size_t* frames_read);
+
+/**
+ * @brief Playback state of a player handle
+ */
+typedef enum {
+    WAV_PLAYER_STATE_PLAYING,       /**< More audio to come */
+    WAV_PLAYER_STATE_FINISHED,      /**< All audio has been delivered */
+    WAV_PLAYER_STATE_ERROR,         /**< The write callback or a read failed, playback stopped */
+} wav_player_state_t;
+
+/**
+ * @brief Play at most one block of a player handle
+ * 
+ * Reads and converts one block and passes it to write_cb, then returns.
+ * All playback state lives in the handle, so a single-task event loop can
+ * interleave playback with other work by calling this whenever the sink
+ * can take another block, without a dedicated task or stack. Frames left
+ * over from wav_player_read() are written first.
+ * 
+ * @param handle Player handle
+ * @param write_cb Callback receiving the block, see wav_player_play_file()
+ * @param user_data User data that will be passed to the callback
+ * @param[out] state Optional, receives the state after this step
+ * @return ESP_OK if a block was written or playback has finished
+ *         ESP_ERR_INVALID_ARG if handle or write_cb is NULL
+ *         ESP_ERR_INVALID_STATE if an earlier write or read failed
+ *         ESP_FAIL if the data ended early on a read error or corrupt data
+ *         Error returned by write_cb otherwise
+ */
+esp_err_t wav_player_step(wav_player_handle_t handle, wav_player_write_cb_t write_cb, void* user_data,
+                          wav_player_state_t* state);
+
+/**
+ * @brief Play at most one block of a player handle through a partial-write sink
+ * 
+ * Like wav_player_step(), but write_cb may accept only part of the block or
+ * report that it would block. The remainder is kept in the handle and
+ * passed first on the next call, so the loop can go on with other work
+ * until the sink has room again.
+ * 
+ * Frames partly accepted cannot be handed out by wav_player_read().
+ * 
+ * @param handle Player handle
+ * @param write_cb Callback receiving the block or its remainder
+ * @param user_data User data that will be passed to the callback
+ * @param[out] state Optional, receives the state after this step
+ * @return ESP_OK if the sink took what it was given or playback has finished
+ *         ESP_ERR_TIMEOUT if the sink would block, the remainder is kept
+ *         ESP_ERR_INVALID_ARG if handle or write_cb is NULL
+ *         ESP_ERR_INVALID_STATE if an earlier write or read failed
+ *         ESP_FAIL if the data ended early on a read error or corrupt data
+ *         Error returned by write_cb otherwise
+ */
+esp_err_t wav_player_step_partial(wav_player_handle_t handle, wav_player_write_partial_cb_t write_cb,
+                                  void* user_data, wav_player_state_t* state);
+
+/**
+ * @brief Get the playback state of a player handle
+ * 
+ * @param handle Player handle
+ * @return Current state, WAV_PLAYER_STATE_ERROR if handle is NULL
+ */
+wav_player_state_t wav_player_get_state(wav_player_handle_t handle);
+
+/**
+ * @brief Get the information of the file behind a player handle
+ * 
+ * @param handle Player handle
+ * @param info Pointer to wav_player_info_t structure to store the information
+ * @return ESP_OK on success
+ *         ESP_ERR_INVALID_ARG if an argument is NULL
+ */
+esp_err_t wav_player_handle_get_info(wav_player_handle_t handle, wav_player_info_t* info);
+
+/**
+ * @brief Close a player handle
+ * 
+ * Closing a handle that has not finished ends its playback with a
+ * WAV_PLAYER_EVENT_ERROR event carrying ESP_ERR_INVALID_STATE.
+ * 
+ * @param handle Player handle, NULL is ignored
+ */
+void wav_player_close(wav_player_handle_t handle);
+
 /**
  * @brief Get information about a WAV file
  * 
- * Reads the WAV header and provides format information without playing the file.
+ * Reads and validates the WAV header and provides format information without
+ * playing the file.
  * 
  * @param filepath Path to the WAV file
  * @param header Pointer to wav_header_t structure to store the information
  * @return ESP_OK on success
- *         ESP_FAIL if file cannot be opened or header is invalid
+ *         ESP_FAIL if file cannot be opened or header is invalid or unsupported
  */
 esp_err_t wav_player_get_info(const char* filepath, wav_header_t* header);
 
+/**
+ * @brief Get complete information about a WAV file
+ * 
+ * Walks every RIFF chunk of the file, validates the format and reports the
+ * format tag, data offset, frame count, duration and the chunks found.
+ * 
+ * @param filepath Path to the WAV file
+ * @param info Pointer to wav_player_info_t structure to store the information
+ * @return ESP_OK on success
+ *         ESP_ERR_INVALID_ARG if an argument is NULL
+ *         ESP_FAIL if file cannot be opened or header is invalid or unsupported
+ */
+esp_err_t wav_player_get_info_ex(const char* filepath, wav_player_info_t* info);
+
 /**
  * @brief Set the playback volume
  * 
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "wav_player.h"
+
+/**
+ * @brief Result of parsing one file in a batch
+ */
+typedef struct {
+    esp_err_t err;              /**< ESP_OK if the file is a supported WAV file */
+    wav_header_t header;        /**< Format information, valid if err is ESP_OK */
+    uint32_t data_offset;       /**< Offset of the PCM data in the file */
+    uint32_t duration_ms;       /**< Playback duration in milliseconds, valid if err is ESP_OK */
+} wav_player_batch_info_t;
+
+/**
+ * @brief Files found by wav_player_get_info_dir() and their results
+ */
+typedef struct {
+    size_t count;                       /**< Number of files */
+    char** paths;                       /**< Full path of each file */
+    wav_player_batch_info_t* results;   /**< Result of each file, same order as paths */
+} wav_player_batch_dir_t;
+
+/**
+ * @brief Get information about many WAV files in parallel
+ * 
+ * Header parsing is spread over worker threads pinned to different cores;
+ * the calling task works on the batch too. results[i] always belongs to
+ * paths[i], whatever the order the workers finish in.
+ * 
+ * @param paths Paths of the files to parse
+ * @param count Number of paths
+ * @param results Array of count results to fill
+ * @param num_workers Number of workers including the caller, 0 for one per core
+ * @return ESP_OK if the batch ran, per-file status is in results[i].err
+ *         ESP_ERR_INVALID_ARG if paths or results is NULL
+ */
+esp_err_t wav_player_get_info_batch(const char* const* paths, size_t count,
+                                    wav_player_batch_info_t* results, size_t num_workers);
+
+/**
+ * @brief Get information about all WAV files below a directory in parallel
+ * 
+ * Collects every .wav file of the directory tree and parses them with
+ * wav_player_get_info_batch(). Free the result with wav_player_batch_dir_free().
+ * 
+ * @param dir Directory to scan
+ * @param[out] out Files found and their results
+ * @param num_workers Number of workers including the caller, 0 for one per core
+ * @return ESP_OK on success
+ *         ESP_ERR_INVALID_ARG if an argument is NULL
+ *         ESP_ERR_NO_MEM if the file list cannot be allocated
+ *         ESP_FAIL if dir cannot be opened
+ */
+esp_err_t wav_player_get_info_dir(const char* dir, wav_player_batch_dir_t* out, size_t num_workers);
+
+/**
+ * @brief Free the result of wav_player_get_info_dir()
+ * 
+ * @param dir_info Result to free, NULL is ignored
+ */
+void wav_player_batch_dir_free(wav_player_batch_dir_t* dir_info);
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stddef.h>
+#include "wav_player.h"
+
+/** Maximum label length of a cue point, including the terminator */
+#define WAV_PLAYER_CUE_LABEL_MAX 32
+
+/**
+ * @brief A cue point of a WAV file
+ */
+typedef struct {
+    uint32_t id;                /**< Cue identifier from the cue chunk */
+    uint32_t frame;             /**< Frame of the data chunk the cue marks */
+    char label[WAV_PLAYER_CUE_LABEL_MAX]; /**< Text of the matching adtl labl chunk, truncated, empty if none */
+} wav_player_cue_t;
+
+/**
+ * @brief Read the cue points of a file
+ *
+ * Cues come from the cue chunk and their labels from the labl entries of a
+ * LIST/adtl chunk. They are returned sorted by frame.
+ *
+ * @param filepath Path to the WAV file
+ * @param[out] cues Receives up to max_cues cue points, may be NULL if max_cues is 0
+ * @param max_cues Capacity of cues
+ * @param[out] count Receives the number of cue points in the file, which may exceed max_cues
+ * @return ESP_OK on success, also for a file without cues
+ *         ESP_ERR_INVALID_ARG if filepath or count is NULL
+ *         ESP_ERR_NO_MEM if the cue table cannot be allocated
+ *         ESP_FAIL if file cannot be opened or has invalid format
+ */
+esp_err_t wav_player_get_cues(const char* filepath, wav_player_cue_t* cues, size_t max_cues, size_t* count);
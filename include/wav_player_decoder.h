@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stddef.h>
+#include "wav_player.h"
+
+/**
+ * @brief Handle of a push-mode decoder
+ */
+typedef struct wav_player_decoder* wav_player_decoder_t;
+
+/**
+ * @brief Create a decoder for a WAV stream arriving in fragments
+ *
+ * The decoder parses the RIFF header, skips chunks other than fmt and data
+ * and converts the PCM data to 16-bit stereo with the current volume and
+ * effect chain applied, like file playback. Input can be cut anywhere: a
+ * header or a frame split across fragments is completed from the next one.
+ * The decoder runs its own copy of the effect chain set when it is created.
+ *
+ * @param[out] decoder Receives the decoder handle
+ * @return ESP_OK on success
+ *         ESP_ERR_INVALID_ARG if decoder is NULL
+ *         ESP_ERR_NO_MEM if the decoder or its effect state cannot be allocated
+ */
+esp_err_t wav_player_decoder_create(wav_player_decoder_t* decoder);
+
+/**
+ * @brief Decode a fragment of the stream
+ *
+ * Consumes input until it is used up or out is full, whichever comes
+ * first, and reports how much of each was used. Frames are converted
+ * straight from the fragment; only the header fields and the bytes of a
+ * frame cut by the end of the fragment are kept in the decoder, so a
+ * fragment does not have to outlive the call. Input left unconsumed
+ * because out is full must be passed again.
+ *
+ * Bytes following the data chunk are consumed and ignored.
+ *
+ * @param decoder Decoder handle
+ * @param in Fragment of the WAV stream
+ * @param in_size Size of the fragment in bytes
+ * @param[out] in_used Bytes of in consumed
+ * @param out Buffer receiving interleaved 16-bit stereo frames
+ * @param out_frames Capacity of out in frames
+ * @param[out] out_produced Frames written to out
+ * @return ESP_OK on success
+ *         ESP_ERR_INVALID_ARG if an argument is NULL
+ *         ESP_FAIL if the stream is not a supported WAV file, every
+ *         following call fails as well
+ */
+esp_err_t wav_player_decoder_decode(wav_player_decoder_t decoder, const void* in, size_t in_size,
+                                    size_t* in_used, int16_t* out, size_t out_frames,
+                                    size_t* out_produced);
+
+/**
+ * @brief Get the information parsed from the stream header
+ *
+ * Chunk offsets are relative to the start of the stream. Chunks after the
+ * data chunk are not listed.
+ *
+ * @param decoder Decoder handle
+ * @param info Pointer to structure to store the information
+ * @return ESP_OK on success
+ *         ESP_ERR_INVALID_ARG if decoder or info is NULL
+ *         ESP_ERR_INVALID_STATE if the header has not been received yet
+ */
+esp_err_t wav_player_decoder_get_info(wav_player_decoder_t decoder, wav_player_info_t* info);
+
+/**
+ * @brief Check whether all frames of the data chunk have been decoded
+ *
+ * @param decoder Decoder handle
+ * @return true once the whole data chunk was decoded
+ */
+bool wav_player_decoder_is_done(wav_player_decoder_t decoder);
+
+/**
+ * @brief Reset a decoder to decode a new stream
+ *
+ * Also clears the state of the decoder's effects.
+ *
+ * @param decoder Decoder handle
+ */
+void wav_player_decoder_reset(wav_player_decoder_t decoder);
+
+/**
+ * @brief Free a decoder
+ *
+ * @param decoder Decoder handle, may be NULL
+ */
+void wav_player_decoder_delete(wav_player_decoder_t decoder);
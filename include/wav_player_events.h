@@ -0,0 +1,57 @@
+#pragma once
+
+#include "wav_player.h"
+#include "wav_player_cue.h"
+
+/**
+ * @brief Playback events
+ */
+typedef enum {
+    WAV_PLAYER_EVENT_START,     /**< The first frames were delivered to the sink */
+    WAV_PLAYER_EVENT_PROGRESS,  /**< Another progress_frames frames were delivered */
+    WAV_PLAYER_EVENT_END,       /**< All frames were delivered */
+    WAV_PLAYER_EVENT_UNDERRUN,  /**< Data was late and concealment started */
+    WAV_PLAYER_EVENT_ERROR,     /**< Playback stopped on an error, ESP_ERR_INVALID_STATE if a handle was closed early */
+    WAV_PLAYER_EVENT_CUE,       /**< The frame of a cue point was delivered */
+} wav_player_event_type_t;
+
+/**
+ * @brief A playback event
+ */
+typedef struct {
+    wav_player_event_type_t type;
+    uint64_t frames;            /**< Frames delivered to the sink so far, including concealment */
+    uint32_t sample_rate;       /**< Sample rate of the playback, frames / sample_rate is the position in seconds */
+    esp_err_t error;            /**< Error that stopped playback, ESP_OK for other events */
+    const wav_player_cue_t* cue; /**< Cue point crossed for WAV_PLAYER_EVENT_CUE, NULL otherwise */
+} wav_player_event_t;
+
+/**
+ * @brief Callback receiving playback events
+ *
+ * Called on the task that delivers audio to the sink (the caller of
+ * wav_player_play_file(), wav_player_read() or wav_player_step()), right
+ * after the write that caused the event. It delays the next block, so it
+ * should only record the event or notify another task.
+ *
+ * @param event The event, valid for the duration of the call
+ * @param user_data User data passed to wav_player_set_event_cb()
+ */
+typedef void (*wav_player_event_cb_t)(const wav_player_event_t* event, void* user_data);
+
+/**
+ * @brief Set the callback receiving events of all playbacks
+ *
+ * Takes effect for playbacks started afterwards. Events are dispatched
+ * without allocation or locking.
+ *
+ * While a callback is set, files are scanned for cue points when they are
+ * opened and a cue event follows the write that delivers a cue's frame.
+ * The cue table is parsed along with the header of the open file, cached
+ * files keep theirs, and checking it costs one comparison per block.
+ *
+ * @param cb Event callback, NULL to disable events
+ * @param user_data User data that will be passed to the callback
+ * @param progress_frames Frames between progress events, 0 for none
+ */
+void wav_player_set_event_cb(wav_player_event_cb_t cb, void* user_data, uint32_t progress_frames);
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <stddef.h>
+#include "wav_player.h"
+
+/** Maximum number of effects in the chain */
+#define WAV_PLAYER_FX_MAX 8
+
+/**
+ * @brief An effect in the playback chain
+ *
+ * The chain runs on every converted block, after the volume. Each call
+ * processes one channel of interleaved 16-bit stereo in place. An effect
+ * must keep separate state per channel and touch only the state of the
+ * channel it is called for; the chain can then run both channels at the
+ * same time on different cores with output identical to running them one
+ * after another.
+ *
+ * Every playback runs its own copy of the chain. An effect that keeps state
+ * provides create, called when a playback starts, so concurrent playbacks
+ * never share filter or limiter state. Effects without create are called
+ * with the same ctx by every playback and must not keep state in it.
+ */
+typedef struct {
+    /**
+     * @brief Process one channel of a block in place
+     *
+     * @param ctx Effect context
+     * @param channel 0 for left, 1 for right
+     * @param samples First sample of the channel
+     * @param frames Number of samples to process
+     * @param stride Distance between consecutive samples of the channel
+     */
+    void (*process)(void* ctx, int channel, int16_t* samples, size_t frames, size_t stride);
+    void (*reset)(void* ctx, int channel);  /**< Optional, clears the state of a channel */
+    void* ctx;                              /**< Effect context, passed to create or, without it, to process */
+    void* (*create)(void* ctx);             /**< Optional, returns the cleared state of one playback, passed to
+                                                 process and reset as ctx, NULL if it cannot be allocated */
+    void (*destroy)(void* state);           /**< Optional, frees a state returned by create */
+} wav_player_fx_t;
+
+/**
+ * @brief Result of wav_player_fx_benchmark()
+ */
+typedef struct {
+    uint64_t serial_us;         /**< Time to process all blocks on one core */
+    uint64_t parallel_us;       /**< Time to process all blocks with channels in parallel */
+    bool identical;             /**< Whether both runs produced the same output */
+} wav_player_fx_benchmark_t;
+
+/**
+ * @brief Set the effect chain applied to all playback
+ *
+ * The effects are copied and run in order. Playbacks started afterwards
+ * use the new chain, each with state of its own from the effects' create
+ * functions; playbacks already running keep the chain they started with.
+ *
+ * @param chain Effects, may be NULL if count is 0
+ * @param count Number of effects, 0 removes the chain
+ * @return ESP_OK on success
+ *         ESP_ERR_INVALID_ARG if count exceeds WAV_PLAYER_FX_MAX or an effect has no process function
+ */
+esp_err_t wav_player_fx_set_chain(const wav_player_fx_t* chain, size_t count);
+
+/**
+ * @brief Run the chain for the right channel on a worker core
+ *
+ * While enabled, the right channel of every block is processed by a worker
+ * task pinned to core_id while the playback task processes the left
+ * channel, roughly halving the time spent in the chain.
+ *
+ * @param enable true to start the worker, false to stop it
+ * @param core_id Core of the worker, -1 for any
+ * @return ESP_OK on success
+ *         ESP_ERR_NO_MEM if the worker cannot be started
+ */
+esp_err_t wav_player_fx_set_parallel(bool enable, int core_id);
+
+/**
+ * @brief Reset the shared state of effects without a create function
+ *
+ * Effects with create start every playback from a fresh state.
+ */
+void wav_player_fx_reset(void);
+
+/**
+ * @brief Measure the chain on synthetic stereo noise
+ *
+ * Runs the chain over the same input first on the calling task alone, then
+ * with the channels in parallel. Each run uses a fresh state from every
+ * effect's create, so playback can continue meanwhile. Effects without
+ * create share their ctx with live playbacks and cannot be measured.
+ *
+ * @param block_frames Frames per block
+ * @param blocks Number of blocks per run
+ * @param[out] result Timings and whether the outputs matched
+ * @return ESP_OK on success
+ *         ESP_ERR_INVALID_ARG if an argument is 0 or NULL
+ *         ESP_ERR_INVALID_STATE if parallel processing is not enabled
+ *         ESP_ERR_NOT_SUPPORTED if an effect has no create function
+ *         ESP_ERR_NO_MEM if the test buffers or effect states cannot be allocated
+ */
+esp_err_t wav_player_fx_benchmark(size_t block_frames, size_t blocks, wav_player_fx_benchmark_t* result);
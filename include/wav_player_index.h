@@ -0,0 +1,126 @@
+#pragma once
+
+#include "wav_player.h"
+
+/**
+ * Persistent metadata index
+ *
+ * Keeps one compact record per WAV file of an asset directory so formats can
+ * be looked up at boot without opening every file. The index is scanned once,
+ * saved to storage and reloaded; later scans only re-parse files whose size or
+ * modification time changed. Files that are not supported WAV files keep a
+ * record too, marked invalid, so they are not parsed again until they change.
+ * Lookups are O(1) through a hash table keyed by the FNV-1a hash of the file
+ * path, and the stored path confirms a match, so files whose paths share a
+ * hash are told apart.
+ */
+
+#define WAV_PLAYER_INDEX_MAGIC "WIDX"
+#define WAV_PLAYER_INDEX_VERSION 2
+
+/**
+ * @brief Per-file index record (32 bytes, stored as-is in the index file)
+ */
+typedef struct {
+    uint32_t path_hash;         /**< FNV-1a hash of the full file path */
+    uint32_t mtime;             /**< File modification time (seconds) */
+    uint32_t file_size;         /**< File size in bytes */
+    uint32_t data_offset;       /**< Offset of the PCM data in the file */
+    uint32_t data_size;         /**< Size of audio data in bytes */
+    uint32_t sample_rate;       /**< Sample rate in Hz */
+    uint32_t duration_ms;       /**< Playback duration in milliseconds */
+    uint8_t num_channels;       /**< Number of audio channels */
+    uint8_t bits_per_sample;    /**< Bits per sample */
+    uint16_t block_align;       /**< Block alignment, 0 marks a file that is not a supported WAV file */
+} wav_player_index_entry_t;
+
+/**
+ * @brief Handle of a metadata index
+ */
+typedef struct wav_player_index* wav_player_index_handle_t;
+
+/**
+ * @brief Load an index from storage
+ *
+ * If the index file does not exist or is corrupt an empty index is returned,
+ * so the first scan fills it.
+ *
+ * @param index_path Path of the index file, NULL for an empty in-memory index
+ * @param[out] out_index Handle of the loaded index
+ * @return ESP_OK on success
+ *         ESP_ERR_INVALID_ARG if out_index is NULL
+ *         ESP_ERR_NO_MEM if the index cannot be allocated
+ */
+esp_err_t wav_player_index_load(const char* index_path, wav_player_index_handle_t* out_index);
+
+/**
+ * @brief Scan a directory tree and update the index
+ *
+ * Every .wav file below dir is checked with stat(). Files whose size and
+ * modification time match their record are kept as-is, new or changed files
+ * have their header parsed, and records of removed files are dropped. Files
+ * with an unsupported format are recorded as invalid and not returned by
+ * lookups.
+ *
+ * @param index Index handle
+ * @param dir Directory to scan, records are keyed by "<dir>/<relative path>"
+ * @param[out] rescanned Number of files whose header was parsed (may be NULL)
+ * @return ESP_OK on success
+ *         ESP_ERR_INVALID_ARG if an argument is NULL
+ *         ESP_ERR_NO_MEM if the index cannot grow
+ *         ESP_FAIL if dir cannot be opened
+ */
+esp_err_t wav_player_index_scan(wav_player_index_handle_t index, const char* dir, size_t* rescanned);
+
+/**
+ * @brief Save the index to storage
+ *
+ * Writes to a temporary file first and renames it, so a power loss never
+ * leaves a truncated index behind.
+ *
+ * @param index Index handle
+ * @param index_path Path of the index file
+ * @return ESP_OK on success
+ *         ESP_ERR_INVALID_ARG if an argument is NULL
+ *         ESP_FAIL if the file cannot be written
+ */
+esp_err_t wav_player_index_save(wav_player_index_handle_t index, const char* index_path);
+
+/**
+ * @brief Look up the record of a file
+ *
+ * @param index Index handle
+ * @param filepath Full file path, as built by wav_player_index_scan()
+ * @return Pointer to the record (valid until the next scan), NULL if not indexed
+ *         or not a supported WAV file
+ */
+const wav_player_index_entry_t* wav_player_index_lookup(wav_player_index_handle_t index, const char* filepath);
+
+/**
+ * @brief Get format information of an indexed file
+ *
+ * Drop-in replacement for wav_player_get_info() that never touches storage.
+ *
+ * @param index Index handle
+ * @param filepath Full file path
+ * @param header Pointer to wav_header_t structure to store the information
+ * @return ESP_OK on success
+ *         ESP_ERR_INVALID_ARG if an argument is NULL
+ *         ESP_ERR_NOT_FOUND if the file is not indexed
+ */
+esp_err_t wav_player_index_get_info(wav_player_index_handle_t index, const char* filepath, wav_header_t* header);
+
+/**
+ * @brief Get the number of indexed files
+ *
+ * @param index Index handle
+ * @return Number of indexed supported WAV files
+ */
+size_t wav_player_index_count(wav_player_index_handle_t index);
+
+/**
+ * @brief Free an index
+ *
+ * @param index Index handle, NULL is ignored
+ */
+void wav_player_index_free(wav_player_index_handle_t index);
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "wav_player.h"
+
+/**
+ * @brief Loop region of a playback
+ */
+typedef struct {
+    uint32_t start_frame;       /**< First frame of the loop */
+    uint32_t end_frame;         /**< Frame after the last frame of the loop */
+    uint32_t count;             /**< Times the loop plays, 0 to loop until the write callback fails */
+} wav_player_loop_t;
+
+/**
+ * @brief Read the first loop of a file's smpl chunk
+ *
+ * Served from the handle pool or prefetch cache when the file is cached.
+ *
+ * @param filepath Path to the WAV file
+ * @param[out] loop Loop region, with the smpl end point converted to an exclusive end
+ * @return ESP_OK on success
+ *         ESP_ERR_INVALID_ARG if an argument is NULL
+ *         ESP_ERR_NOT_FOUND if the file has no smpl chunk with a loop
+ *         ESP_FAIL if file cannot be opened or has invalid format
+ */
+esp_err_t wav_player_get_loop(const char* filepath, wav_player_loop_t* loop);
+
+/**
+ * @brief Play a WAV file, repeating a loop region without a gap
+ *
+ * Plays from the start of the file into the loop, repeats the loop count
+ * times and then plays on to the end of the file. The start of the loop is
+ * kept in RAM, so the jump back is stitched into the same block without a
+ * gap. The read that crosses the loop end seeks the file behind the buffered
+ * part; that seek is the only storage access at the seam, and the next read
+ * from storage follows once the buffered part has played. With the read
+ * scheduler enabled both run in its I/O task.
+ *
+ * Without a region the smpl chunk is parsed while the file is opened.
+ *
+ * @param filepath Path to the WAV file to play
+ * @param loop Loop region, NULL to use the smpl chunk of the file
+ * @param write_cb Callback function that will receive the audio data
+ * @param user_data User data that will be passed to the callback
+ * @return ESP_OK on successful playback
+ *         ESP_ERR_INVALID_ARG if write_cb is NULL or the loop region is empty or beyond the data
+ *         ESP_ERR_NOT_FOUND if loop is NULL and the file has no loop
+ *         ESP_ERR_NO_MEM if the loop buffer cannot be allocated
+ *         ESP_FAIL if file cannot be opened or has invalid format
+ *         Error returned by write_cb otherwise
+ */
+esp_err_t wav_player_play_file_loop(const char* filepath, const wav_player_loop_t* loop,
+                                    wav_player_write_cb_t write_cb, void* user_data);
+
+/**
+ * @brief Open a WAV file for pull-mode playback with a loop region
+ *
+ * Like wav_player_open(), with the looping of wav_player_play_file_loop().
+ *
+ * @param filepath Path to the WAV file
+ * @param loop Loop region, NULL to use the smpl chunk of the file
+ * @param[out] handle Receives the player handle
+ * @return ESP_OK on success
+ *         ESP_ERR_INVALID_ARG if an argument is NULL or the loop region is invalid
+ *         ESP_ERR_NOT_FOUND if loop is NULL and the file has no loop
+ *         ESP_ERR_NO_MEM if the handle cannot be allocated
+ *         ESP_FAIL if file cannot be opened or has invalid format
+ */
+esp_err_t wav_player_open_loop(const char* filepath, const wav_player_loop_t* loop,
+                               wav_player_handle_t* handle);
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "wav_player.h"
+
+/**
+ * LZ4 PCM container ("WLZ4")
+ * 
+ * Lossless container holding the PCM data of a WAV file as independently
+ * LZ4-compressed blocks, followed by a block offset table used for seeking.
+ * Create containers on the host with tools/wav_lz4_pack.py.
+ * 
+ * Layout (little-endian):
+ *   0   char[4]  magic "WLZ4"
+ *   4   u16      version (1)
+ *   6   u16      num_channels
+ *   8   u32      sample_rate
+ *   12  u16      bits_per_sample
+ *   14  u16      block_align
+ *   16  u32      data_size       uncompressed PCM size in bytes
+ *   20  u32      block_size      uncompressed bytes per block (last block may be shorter)
+ *   24  u32      block_count
+ *   28  u32[block_count + 1]     absolute file offset of each block, last entry marks the end
+ * 
+ * A block whose stored size equals its uncompressed size is stored raw.
+ */
+
+#define WAV_PLAYER_LZ4_MAGIC "WLZ4"
+#define WAV_PLAYER_LZ4_VERSION 1
+
+/**
+ * @brief Get information about an LZ4 PCM container
+ * 
+ * @param filepath Path to the container file
+ * @param header Pointer to wav_header_t structure to store the information
+ * @return ESP_OK on success
+ *         ESP_FAIL if file cannot be opened or is not a valid container
+ */
+esp_err_t wav_player_lz4_get_info(const char* filepath, wav_header_t* header);
+
+/**
+ * @brief Play an LZ4 PCM container using the provided write callback
+ * 
+ * Blocks are decompressed one at a time straight into the player's input
+ * buffer. The start position is resolved through the block offset table, so
+ * only the block containing start_frame is read before playback begins.
+ * 
+ * @param filepath Path to the container file
+ * @param start_frame First frame to play (0 to play from the beginning)
+ * @param write_cb Callback function that will receive the audio data
+ * @param user_data User data that will be passed to the callback
+ * @return ESP_OK on successful playback
+ *         ESP_ERR_INVALID_ARG if write_cb is NULL or start_frame is past the end
+ *         ESP_ERR_NO_MEM if buffers cannot be allocated
+ *         ESP_FAIL if file cannot be opened or has invalid format, or a block is corrupt or cannot be read
+ */
+esp_err_t wav_player_play_lz4(const char* filepath, uint32_t start_frame,
+                              wav_player_write_cb_t write_cb, void* user_data);
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stddef.h>
+#include "wav_player.h"
+
+/** Maximum number of clips a mixer plays at the same time */
+#define WAV_PLAYER_MIXER_MAX_VOICES 8
+
+/**
+ * @brief Handle of a mixer
+ */
+typedef struct wav_player_mixer* wav_player_mixer_t;
+
+/**
+ * @brief Create a mixer summing clips into one 16-bit stereo stream
+ *
+ * The mixer counts the frames it has produced; that count is the clock
+ * clips are scheduled against, so start times are exact to the sample
+ * regardless of task timing or the tick rate. Clips are not resampled and
+ * must have the mixer's sample rate.
+ *
+ * @param sample_rate Sample rate of the output and of all clips
+ * @param[out] mixer Receives the mixer handle
+ * @return ESP_OK on success
+ *         ESP_ERR_INVALID_ARG if mixer is NULL or sample_rate is 0
+ *         ESP_ERR_NO_MEM if the mixer cannot be allocated
+ */
+esp_err_t wav_player_mixer_create(uint32_t sample_rate, wav_player_mixer_t* mixer);
+
+/**
+ * @brief Schedule a clip to start at an output frame
+ *
+ * Opens the clip right away, so the file is parsed and its first block
+ * can be read before the start time. wav_player_mixer_read() starts it at
+ * exactly start_frame, inside a block if need be. A start time that has
+ * already passed starts the clip with the next frame read.
+ *
+ * @param mixer Mixer handle
+ * @param filepath Path to the WAV file
+ * @param start_frame Output frame to start at, see wav_player_mixer_get_frame()
+ * @return ESP_OK on success
+ *         ESP_ERR_INVALID_ARG if an argument is NULL or the clip's sample rate differs
+ *         ESP_ERR_NO_MEM if all voices are busy or the clip cannot be opened for lack of memory
+ *         ESP_FAIL if file cannot be opened or has invalid format
+ */
+esp_err_t wav_player_mixer_schedule(wav_player_mixer_t mixer, const char* filepath, uint64_t start_frame);
+
+/**
+ * @brief Produce mixed output
+ *
+ * Always fills out completely, with silence where no clip plays, and
+ * advances the mixer clock by frames. Clips are summed with saturation and
+ * closed once they end.
+ *
+ * Clips are read without holding the lock that wav_player_mixer_schedule()
+ * and wav_player_mixer_get_frame() take, so they never wait for storage.
+ * The clock advances when a read starts; a clip scheduled meanwhile joins
+ * the next read.
+ *
+ * @param mixer Mixer handle
+ * @param out Output buffer, must hold frames * 2 samples
+ * @param frames Number of frames to produce
+ * @return ESP_OK on success
+ *         ESP_ERR_INVALID_ARG if mixer or out is NULL
+ */
+esp_err_t wav_player_mixer_read(wav_player_mixer_t mixer, int16_t* out, size_t frames);
+
+/**
+ * @brief Get the mixer clock
+ *
+ * @param mixer Mixer handle
+ * @return Index of the next output frame, i.e. frames produced so far
+ */
+uint64_t wav_player_mixer_get_frame(wav_player_mixer_t mixer);
+
+/**
+ * @brief Stop all clips and free a mixer
+ *
+ * @param mixer Mixer handle, may be NULL
+ */
+void wav_player_mixer_delete(wav_player_mixer_t mixer);
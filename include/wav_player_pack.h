@@ -0,0 +1,92 @@
+#pragma once
+
+#include "wav_player.h"
+
+/**
+ * WAV asset pack ("WPAK")
+ * 
+ * Single file holding the PCM data of many clips, preceded by a directory of
+ * pre-parsed formats. A pack is opened once and keeps its file handle open, so
+ * playing a clip costs a seek instead of a path lookup and fopen. Create packs
+ * on the host with tools/wav_asset_pack.py.
+ * 
+ * Layout (little-endian):
+ *   0   char[4]  magic "WPAK"
+ *   4   u16      version (2)
+ *   6   u16      entry_count
+ *   8   u32      names_size
+ *   12  entry[entry_count], sorted by name_hash, 28 bytes each:
+ *         u32 name_hash      FNV-1a hash of the clip name
+ *         u32 data_offset    absolute offset of the PCM data
+ *         u32 data_size      size of the PCM data in bytes
+ *         u32 sample_rate
+ *         u16 num_channels
+ *         u16 bits_per_sample
+ *         u16 block_align
+ *         u16 reserved
+ *         u32 name_offset    offset of the clip name in the name table
+ *   ..  char[names_size]     name table, NUL-terminated clip names
+ * 
+ * Lookups binary search the hashes and confirm a hit against the stored
+ * name, so a name missing from the pack is never mistaken for a clip with
+ * the same hash.
+ */
+
+#define WAV_PLAYER_PACK_MAGIC "WPAK"
+#define WAV_PLAYER_PACK_VERSION 2
+
+/**
+ * @brief Handle of an open asset pack
+ */
+typedef struct wav_player_pack* wav_player_pack_handle_t;
+
+/**
+ * @brief Open an asset pack and load its directory
+ * 
+ * @param filepath Path to the pack file
+ * @param[out] out_pack Handle of the opened pack
+ * @return ESP_OK on success
+ *         ESP_ERR_INVALID_ARG if an argument is NULL
+ *         ESP_ERR_NO_MEM if the directory or name table cannot be allocated
+ *         ESP_FAIL if file cannot be opened or is not a valid version 2 pack
+ */
+esp_err_t wav_player_pack_open(const char* filepath, wav_player_pack_handle_t* out_pack);
+
+/**
+ * @brief Close an asset pack
+ * 
+ * No clip of the pack may be playing.
+ * 
+ * @param pack Pack handle, NULL is ignored
+ */
+void wav_player_pack_close(wav_player_pack_handle_t pack);
+
+/**
+ * @brief Get information about a clip in a pack
+ * 
+ * @param pack Pack handle
+ * @param name Clip name as stored by the packing tool
+ * @param header Pointer to wav_header_t structure to store the information
+ * @return ESP_OK on success
+ *         ESP_ERR_INVALID_ARG if an argument is NULL
+ *         ESP_ERR_NOT_FOUND if the pack has no clip with this name
+ */
+esp_err_t wav_player_pack_get_info(wav_player_pack_handle_t pack, const char* name, wav_header_t* header);
+
+/**
+ * @brief Play a clip from a pack using the provided write callback
+ * 
+ * Several clips of the same pack may be played concurrently from different
+ * tasks, reads on the shared file handle are serialized.
+ * 
+ * @param pack Pack handle
+ * @param name Clip name as stored by the packing tool
+ * @param write_cb Callback function that will receive the audio data
+ * @param user_data User data that will be passed to the callback
+ * @return ESP_OK on successful playback
+ *         ESP_ERR_INVALID_ARG if an argument is NULL
+ *         ESP_ERR_NOT_FOUND if the pack has no clip with this name
+ *         ESP_FAIL if the clip has an unsupported format
+ */
+esp_err_t wav_player_pack_play(wav_player_pack_handle_t pack, const char* name,
+                               wav_player_write_cb_t write_cb, void* user_data);
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "wav_player.h"
+
+/**
+ * @brief Pipelined playback configuration
+ */
+typedef struct {
+    int io_core;                /**< Core reading from the source, -1 for any */
+    int dsp_core;               /**< Core converting blocks, -1 for any */
+    size_t queue_depth;         /**< Blocks in each queue between stages */
+} wav_player_pipeline_config_t;
+
+#define WAV_PLAYER_PIPELINE_CONFIG_DEFAULT() { \
+    .io_core = 0,                              \
+    .dsp_core = 1,                             \
+    .queue_depth = 4,                          \
+}
+
+/**
+ * @brief Pipelined playback statistics, accumulated over all playbacks
+ *
+ * A stage's utilization is its busy time divided by elapsed_us.
+ */
+typedef struct {
+    uint64_t elapsed_us;        /**< Wall time of pipelined playbacks */
+    uint64_t read_busy_us;      /**< Time the I/O stage spent reading */
+    uint64_t convert_busy_us;   /**< Time the DSP stage spent converting */
+    uint64_t write_busy_us;     /**< Time the output stage spent in the write callback */
+    uint32_t blocks;            /**< Blocks written */
+    uint32_t read_blocked;      /**< Times the I/O stage waited for a free block */
+    uint32_t convert_starved;   /**< Times the DSP stage waited for input */
+    uint32_t write_starved;     /**< Times the output stage waited for a converted block */
+} wav_player_pipeline_stats_t;
+
+/**
+ * @brief Enable pipelined playback
+ *
+ * While enabled, every playback runs as three stages connected by bounded
+ * queues of queue_depth blocks: a task pinned to io_core reads blocks from
+ * the source, a task pinned to dsp_core converts them and applies the
+ * volume, and the calling task only runs the write callback. Reading the
+ * next blocks, converting and output then overlap instead of running one
+ * after another on the caller's core.
+ *
+ * On the Linux host target the stages run as plain threads. On single-core
+ * chips the stages are not pinned. If the stage tasks cannot be created the
+ * playback runs serially.
+ *
+ * @param config Pipeline configuration, NULL for WAV_PLAYER_PIPELINE_CONFIG_DEFAULT()
+ * @return ESP_OK on success
+ *         ESP_ERR_INVALID_ARG if queue_depth is 0
+ *         ESP_ERR_INVALID_STATE if the pipeline is already enabled
+ */
+esp_err_t wav_player_pipeline_init(const wav_player_pipeline_config_t* config);
+
+/**
+ * @brief Get pipelined playback statistics
+ *
+ * @param stats Pointer to structure to store the statistics
+ * @return ESP_OK on success
+ *         ESP_ERR_INVALID_ARG if stats is NULL
+ */
+esp_err_t wav_player_pipeline_get_stats(wav_player_pipeline_stats_t* stats);
+
+/**
+ * @brief Clear pipelined playback statistics
+ */
+void wav_player_pipeline_reset_stats(void);
+
+/**
+ * @brief Disable pipelined playback
+ *
+ * Playbacks already running finish pipelined.
+ */
+void wav_player_pipeline_deinit(void);
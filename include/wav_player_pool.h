@@ -0,0 +1,35 @@
+#pragma once
+
+#include "wav_player.h"
+
+/**
+ * @brief Enable the file handle pool
+ * 
+ * While enabled, wav_player_play_file() keeps files open after playback
+ * together with their parsed header. Playing the same path again reuses the
+ * handle and seeks to the data instead of opening and parsing the file. When
+ * the pool is full the least recently used idle handle is closed.
+ * 
+ * Pooled handles count against the max_files limit of the mounted filesystem.
+ * 
+ * @param max_handles Maximum number of files kept open
+ * @return ESP_OK on success
+ *         ESP_ERR_INVALID_ARG if max_handles is 0
+ *         ESP_ERR_INVALID_STATE if the pool is already enabled
+ *         ESP_ERR_NO_MEM if the pool cannot be allocated
+ */
+esp_err_t wav_player_pool_init(size_t max_handles);
+
+/**
+ * @brief Close all idle pooled files
+ * 
+ * Call after files were modified or deleted, so later plays open them again.
+ */
+void wav_player_pool_flush(void);
+
+/**
+ * @brief Disable the file handle pool and close all pooled files
+ * 
+ * No file may be playing.
+ */
+void wav_player_pool_deinit(void);
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "wav_player.h"
+
+/**
+ * @brief Playback position
+ */
+typedef struct {
+    uint64_t delivered_frames;  /**< Frames accepted by the sink, including concealment */
+    uint64_t played_frames;     /**< delivered_frames minus the frames still queued in the sink */
+    uint32_t delivered_ms;      /**< delivered_frames in milliseconds */
+    uint32_t played_ms;         /**< played_frames in milliseconds */
+    uint32_t sample_rate;       /**< Sample rate of the playback */
+} wav_player_position_t;
+
+/**
+ * @brief Get the position of the most recently started playback
+ *
+ * Covers every kind of playback, including player handles. The position
+ * is updated after each write to the sink and keeps its final value once
+ * the playback ends. Lock-free, can be called from any task at any rate,
+ * for example to drive animations in step with the audio.
+ *
+ * @param pos Pointer to structure to store the position
+ * @return ESP_OK on success
+ *         ESP_ERR_INVALID_ARG if pos is NULL
+ *         ESP_ERR_INVALID_STATE if nothing has played yet
+ */
+esp_err_t wav_player_get_position(wav_player_position_t* pos);
+
+/**
+ * @brief Get the position of a player handle
+ *
+ * Lock-free, can be called from any task while the handle is open.
+ * played_frames uses the latency reported with
+ * wav_player_handle_set_sink_latency().
+ *
+ * @param handle Player handle
+ * @param pos Pointer to structure to store the position
+ * @return ESP_OK on success
+ *         ESP_ERR_INVALID_ARG if handle or pos is NULL
+ */
+esp_err_t wav_player_handle_get_position(wav_player_handle_t handle, wav_player_position_t* pos);
+
+/**
+ * @brief Report how many delivered frames the sink has not played yet
+ *
+ * Call from the write callback or the output task whenever it knows, for
+ * example from the fill level of the I2S DMA buffers. Without a report
+ * played_frames equals delivered_frames.
+ *
+ * Applies to wav_player_get_position(), whose playbacks are assumed to
+ * share one sink; the report carries over to the next playback. Player
+ * handles feed sinks of their own, see wav_player_handle_set_sink_latency().
+ *
+ * @param frames Frames queued in the sink
+ */
+void wav_player_set_sink_latency(uint32_t frames);
+
+/**
+ * @brief Report how many frames delivered by a player handle its sink has not played yet
+ *
+ * Like wav_player_set_sink_latency() for the position of one handle.
+ *
+ * @param handle Player handle
+ * @param frames Frames queued in the sink
+ * @return ESP_OK on success
+ *         ESP_ERR_INVALID_ARG if handle is NULL
+ */
+esp_err_t wav_player_handle_set_sink_latency(wav_player_handle_t handle, uint32_t frames);
+
+/**
+ * @brief Convert a frame count to milliseconds
+ *
+ * @param frames Number of frames
+ * @param sample_rate Sample rate, see wav_player_position_t
+ * @return frames in milliseconds, 0 if sample_rate is 0
+ */
+uint64_t wav_player_frames_to_ms(uint64_t frames, uint32_t sample_rate);
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "wav_player.h"
+
+/**
+ * @brief Enable prefetching
+ * 
+ * Starts a background worker and reserves a cache budget for the heads of
+ * prefetched files. The cache is allocated from PSRAM when available.
+ * 
+ * @param cache_bytes Maximum total size of cached audio data
+ * @return ESP_OK on success
+ *         ESP_ERR_INVALID_ARG if cache_bytes is 0
+ *         ESP_ERR_INVALID_STATE if prefetching is already enabled
+ *         ESP_ERR_NO_MEM if the worker cannot be started
+ */
+esp_err_t wav_player_prefetch_init(size_t cache_bytes);
+
+/**
+ * @brief Warm up files that are about to be played
+ * 
+ * Returns immediately. In the background each file is opened, parsed and the
+ * first head_ms milliseconds of audio are read into the cache. A later
+ * wav_player_play_file() of a cached file delivers its first samples from RAM
+ * and continues from storage, through a file opened without parsing before
+ * playback starts. When the cache budget is exceeded the least
+ * recently used heads are dropped. With the file handle pool enabled the
+ * files are also left open in the pool.
+ * 
+ * @param paths Paths of the files, copied before returning
+ * @param count Number of paths
+ * @param head_ms Length of audio to cache per file in milliseconds
+ * @return ESP_OK if the request was queued
+ *         ESP_ERR_INVALID_ARG if paths is NULL or head_ms is 0
+ *         ESP_ERR_INVALID_STATE if prefetching is not enabled
+ *         ESP_ERR_NO_MEM if the request cannot be queued
+ */
+esp_err_t wav_player_prefetch(const char* const* paths, size_t count, uint32_t head_ms);
+
+/**
+ * @brief Drop all cached heads that are not being played
+ */
+void wav_player_prefetch_clear(void);
+
+/**
+ * @brief Disable prefetching, stop the worker and free the cache
+ * 
+ * Pending requests are discarded. No prefetched file may be playing.
+ */
+void wav_player_prefetch_deinit(void);
@@ -0,0 +1,141 @@
+#pragma once
+
+#include "wav_player.h"
+
+#define WAV_PLAYER_SCHED_UNDERRUN_LOG 16
+
+/**
+ * @brief What scheduled playback outputs when data is late
+ */
+typedef enum {
+    WAV_PLAYER_UNDERRUN_WAIT,       /**< Block until data arrives */
+    WAV_PLAYER_UNDERRUN_FADE,       /**< Fade from the last sample to silence */
+    WAV_PLAYER_UNDERRUN_REPEAT,     /**< Repeat the last block while fading it out */
+} wav_player_underrun_policy_t;
+
+/**
+ * @brief Read scheduler configuration
+ */
+typedef struct {
+    size_t buffer_size;         /**< Read-ahead buffer per stream in bytes */
+    size_t min_read_size;       /**< Smallest read issued, smaller gaps wait to be coalesced */
+    size_t max_read_size;       /**< Largest single read */
+    uint32_t read_period_ms;    /**< Audio duration each read should cover */
+    size_t max_streams;         /**< Maximum number of concurrently scheduled streams */
+    int core_id;                /**< Core the I/O task is pinned to, -1 for any */
+    bool burst;                 /**< Refill in bursts so storage can idle in between */
+    uint32_t burst_ms;          /**< Burst mode: audio each stream buffers, replaces buffer_size */
+    uint32_t low_watermark_ms;  /**< Burst mode: buffered audio that triggers the next burst */
+    bool adaptive;              /**< Size read-ahead from measured read latency */
+    size_t min_buffer_size;     /**< Adaptive mode: smallest read-ahead buffer, buffer_size is the largest */
+    wav_player_underrun_policy_t underrun_policy; /**< Output when the next block is late */
+    uint32_t underrun_timeout_ms; /**< Wait for data before concealing, unused with WAV_PLAYER_UNDERRUN_WAIT */
+} wav_player_sched_config_t;
+
+#define WAV_PLAYER_SCHED_CONFIG_DEFAULT() { \
+    .buffer_size = 32 * 1024,               \
+    .min_read_size = 4 * 1024,              \
+    .max_read_size = 16 * 1024,             \
+    .read_period_ms = 250,                  \
+    .max_streams = 4,                       \
+    .core_id = -1,                          \
+    .burst = false,                         \
+    .burst_ms = 4000,                       \
+    .low_watermark_ms = 500,                \
+    .adaptive = false,                      \
+    .min_buffer_size = 16 * 1024,           \
+    .underrun_policy = WAV_PLAYER_UNDERRUN_WAIT, \
+    .underrun_timeout_ms = 20,              \
+}
+
+/**
+ * @brief Read scheduler statistics
+ */
+typedef struct {
+    uint32_t reads;             /**< Reads issued to storage */
+    uint64_t bytes_read;        /**< Bytes read from storage */
+    uint32_t stalls;            /**< Times a stream had to wait for data */
+    uint32_t active_streams;    /**< Streams currently scheduled */
+    uint32_t bursts;            /**< Burst refills started (burst mode) */
+    uint64_t io_busy_us;        /**< Time spent reading from storage */
+    uint64_t elapsed_us;        /**< Time since the scheduler was started */
+    uint32_t latency_p50_us;    /**< Median storage read latency (recent reads) */
+    uint32_t latency_p99_us;    /**< 99th percentile storage read latency (recent reads) */
+    uint32_t latency_max_us;    /**< Slowest storage read */
+    size_t buffer_bytes;        /**< Read-ahead memory currently allocated */
+    uint32_t underruns;         /**< Blocks concealed because data was late */
+    int64_t last_underrun_us;   /**< esp_timer time of the last underrun, 0 if none */
+} wav_player_sched_stats_t;
+
+/**
+ * @brief Start the multi-stream read scheduler
+ * 
+ * While running, every playback reads through a single I/O task instead of
+ * issuing its own small reads. The task serves all active streams with
+ * large reads into per-stream read-ahead buffers, always picking the stream
+ * closest to running dry. Each read is sized to cover
+ * read_period_ms of that stream's consumption rate, bounded by the free
+ * buffer space, so storage sees few large requests instead of many
+ * interleaved small ones.
+ * 
+ * In burst mode each stream gets a buffer holding burst_ms of audio,
+ * allocated in PSRAM when available. A stream is left alone until its
+ * buffered audio drops below low_watermark_ms (or runs dry, for a
+ * low_watermark_ms of 0) and is then filled completely
+ * with back-to-back max_read_size reads, so storage can drop into its idle
+ * state between bursts. io_busy_us / elapsed_us in the statistics is the
+ * storage duty cycle.
+ * 
+ * The scheduler measures every storage read. In adaptive mode the
+ * read-ahead of each stream is resized between min_buffer_size and
+ * buffer_size so that it covers the recent 99th percentile read latency for
+ * every active stream with a 2x margin: buffers grow as soon as slow reads
+ * threaten the deadline and shrink again once storage is consistently fast.
+ * In burst mode the same margin raises the refill trigger above
+ * low_watermark_ms when needed.
+ * 
+ * With an underrun policy other than WAV_PLAYER_UNDERRUN_WAIT, a playback
+ * whose next block is not buffered within underrun_timeout_ms outputs a
+ * concealment block instead of stalling the sink: a short fade from the last
+ * sample to silence, or the last block repeated with a fade-out. Further
+ * late blocks are silent and playback resumes with a fade-in once data
+ * arrives.
+ * 
+ * Playbacks started before the scheduler keep reading directly. When
+ * max_streams are active further playbacks also read directly.
+ * 
+ * @param config Scheduler configuration, NULL for WAV_PLAYER_SCHED_CONFIG_DEFAULT()
+ * @return ESP_OK on success
+ *         ESP_ERR_INVALID_ARG if the configuration is inconsistent
+ *         ESP_ERR_INVALID_STATE if the scheduler is already running
+ *         ESP_ERR_NO_MEM if the I/O task cannot be started
+ */
+esp_err_t wav_player_sched_init(const wav_player_sched_config_t* config);
+
+/**
+ * @brief Get read scheduler statistics
+ * 
+ * @param stats Pointer to structure to store the statistics
+ * @return ESP_OK on success
+ *         ESP_ERR_INVALID_ARG if stats is NULL
+ */
+esp_err_t wav_player_sched_get_stats(wav_player_sched_stats_t* stats);
+
+/**
+ * @brief Get the times of the most recent underruns
+ * 
+ * @param[out] timestamps_us Receives up to max esp_timer timestamps, oldest first
+ * @param max Capacity of timestamps_us
+ * @param[out] count Number of timestamps stored, at most WAV_PLAYER_SCHED_UNDERRUN_LOG
+ * @return ESP_OK on success
+ *         ESP_ERR_INVALID_ARG if an argument is NULL
+ */
+esp_err_t wav_player_sched_get_underruns(int64_t* timestamps_us, size_t max, size_t* count);
+
+/**
+ * @brief Stop the read scheduler
+ * 
+ * Scheduled playbacks still running play out what is buffered and then
+ * end with an error instead of waiting for the stopped I/O task.
+ */
+void wav_player_sched_deinit(void);
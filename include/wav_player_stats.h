@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stddef.h>
+#include "wav_player.h"
+
+/** Number of buckets in a latency histogram */
+#define WAV_PLAYER_LATENCY_BUCKETS 24
+
+/** Number of buckets in the real-time budget histogram, 25% each */
+#define WAV_PLAYER_BUDGET_BUCKETS 8
+
+/**
+ * @brief Log-bucketed latency histogram
+ *
+ * buckets[0] counts latencies below 2 us, buckets[i] counts latencies in
+ * [2^i, 2^(i+1)) us, the last bucket also everything slower.
+ */
+typedef struct {
+    uint32_t buckets[WAV_PLAYER_LATENCY_BUCKETS];
+    uint32_t count;             /**< Number of samples */
+    uint64_t total_us;          /**< Sum of all samples */
+    uint32_t max_us;            /**< Slowest sample */
+} wav_player_latency_hist_t;
+
+/**
+ * @brief Per-block timing of all playbacks
+ *
+ * Each block is compared against its real-time budget, the time the sink
+ * needs to play it (block frames / sample_rate).
+ */
+typedef struct {
+    wav_player_latency_hist_t read;     /**< Reading a block from its source */
+    wav_player_latency_hist_t convert;  /**< Converting and scaling a block */
+    wav_player_latency_hist_t write;    /**< The write callback */
+    uint32_t budget[WAV_PLAYER_BUDGET_BUCKETS]; /**< budget[i] counts blocks using [25*i, 25*(i+1))% of their budget, the last bucket also more */
+    uint32_t blocks;            /**< Blocks timed */
+    uint32_t over_budget;       /**< Blocks whose read + convert + write took longer than their duration */
+    uint32_t read_over_budget;  /**< Blocks whose read alone took longer than their duration */
+} wav_player_latency_stats_t;
+
+/**
+ * @brief Get the block timing statistics
+ *
+ * Every playback records how long reading, converting and writing each
+ * block took. The statistics accumulate until reset.
+ *
+ * @param stats Pointer to structure to store the statistics
+ * @return ESP_OK on success
+ *         ESP_ERR_INVALID_ARG if stats is NULL
+ */
+esp_err_t wav_player_get_latency_stats(wav_player_latency_stats_t* stats);
+
+/**
+ * @brief Clear the block timing statistics
+ */
+void wav_player_reset_latency_stats(void);
+
+/**
+ * @brief Latency below which the given share of samples fell
+ *
+ * @param hist Histogram to evaluate
+ * @param percent Percentile, e.g. 99
+ * @return Upper edge of the bucket holding the percentile in us, 0 if empty
+ */
+uint32_t wav_player_latency_percentile(const wav_player_latency_hist_t* hist, uint32_t percent);
+
+/**
+ * @brief Export statistics as JSON
+ *
+ * Writes a single-line JSON object with the read, convert and write
+ * histograms (counts, totals, maxima and bucket arrays), the budget
+ * histogram and the over-budget counters, ready to upload from field units.
+ *
+ * @param stats Statistics to export
+ * @param buf Output buffer, always NUL terminated when size > 0
+ * @param size Size of buf, 2 KB is always enough
+ * @return Length of the complete JSON text, like snprintf; larger than or
+ *         equal to size if it was truncated
+ */
+size_t wav_player_latency_stats_to_json(const wav_player_latency_stats_t* stats, char* buf, size_t size);
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stddef.h>
+#include "wav_player.h"
+
+/**
+ * @brief Trace events
+ *
+ * _BEGIN/_END pairs are spans on the recording task, the others are instant
+ * events marking state changes.
+ */
+typedef enum {
+    WAV_TRACE_PLAY_BEGIN,           /**< Playback starts, arg = sample rate */
+    WAV_TRACE_PLAY_END,             /**< Playback ends, arg = esp_err_t result */
+    WAV_TRACE_READ_BEGIN,           /**< Block read from the source */
+    WAV_TRACE_READ_END,             /**< arg = bytes read */
+    WAV_TRACE_CONVERT_BEGIN,        /**< Block conversion and volume */
+    WAV_TRACE_CONVERT_END,          /**< arg = output bytes */
+    WAV_TRACE_WRITE_BEGIN,          /**< Write callback */
+    WAV_TRACE_WRITE_END,            /**< arg = esp_err_t result */
+    WAV_TRACE_UNDERRUN,             /**< Concealment block written, arg = policy */
+    WAV_TRACE_SCHED_READ_BEGIN,     /**< Read scheduler storage read */
+    WAV_TRACE_SCHED_READ_END,       /**< arg = bytes read */
+    WAV_TRACE_SCHED_BURST,          /**< Burst refill starts, arg = buffered bytes */
+    WAV_TRACE_SCHED_RESIZE,         /**< Read-ahead resized, arg = new size */
+} wav_player_trace_event_t;
+
+/**
+ * @brief One recorded event, also the record layout of saved trace files
+ */
+typedef struct {
+    int64_t time_us;                /**< esp_timer time */
+    uint32_t arg;                   /**< Event specific value */
+    uint16_t event;                 /**< wav_player_trace_event_t */
+    uint16_t task;                  /**< Small id of the recording task */
+} wav_player_trace_record_t;
+
+/**
+ * @brief Copy the recorded events, oldest first
+ *
+ * Tracing is enabled with CONFIG_WAV_PLAYER_TRACE. Events recorded while
+ * copying may be torn, stop playback for an exact snapshot.
+ *
+ * @param records Receives up to max events
+ * @param max Capacity of records
+ * @return Number of events copied, 0 when tracing is disabled
+ */
+size_t wav_player_trace_read(wav_player_trace_record_t* records, size_t max);
+
+/**
+ * @brief Write the recorded events to a file
+ *
+ * The file holds a 16 byte header ("WTRC", version, event count, record
+ * size, little endian) followed by the records. Convert it on the host with
+ * tools/wav_trace_export.py to a Chrome / Perfetto trace.
+ *
+ * @param filepath Output file
+ * @return ESP_OK on success
+ *         ESP_ERR_NOT_SUPPORTED if tracing is disabled
+ *         ESP_ERR_NO_MEM if the snapshot cannot be allocated
+ *         ESP_FAIL if the file cannot be written
+ */
+esp_err_t wav_player_trace_save(const char* filepath);
+
+/**
+ * @brief Discard all recorded events
+ */
+void wav_player_trace_clear(void);
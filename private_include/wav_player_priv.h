@@ -0,0 +1,750 @@
+#pragma once
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "wav_player.h"
+#include "wav_player_sched.h"
+#include "wav_player_stats.h"
+#include "wav_player_events.h"
+#include "wav_player_position.h"
+#include "wav_player_loop.h"
+#include "wav_player_cue.h"
+#include "wav_player_fx.h"
+
+/** Bytes per frame of converted output (16-bit stereo) */
+#define WAV_PLAYER_OUT_FRAME_BYTES 4
+
+static inline uint16_t read_le16(const uint8_t* p) {
+    return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t read_le32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/**
+ * @brief Operations of a PCM byte source
+ * 
+ * A source yields the raw bytes of the WAV data chunk, hiding the container
+ * they are stored in (plain WAV file, compressed pack, ...). A read returns
+ * 0 both at the end of the data and after an I/O error or corrupt data; a
+ * source that can fail records the failure for error() so playback can
+ * report it instead of ending as if the data were complete.
+ */
+typedef struct {
+    size_t (*read)(void* ctx, void* dst, size_t size);   /**< Read up to size bytes, returns 0 at end of data */
+    esp_err_t (*seek)(void* ctx, uint32_t offset);       /**< Seek to a byte offset within the PCM data (optional) */
+    void (*close)(void* ctx);                            /**< Release the source (optional) */
+    esp_err_t (*error)(void* ctx);                       /**< Why reads ended before the end of data, ESP_OK if they did not (optional) */
+} wav_source_ops_t;
+
+/**
+ * @brief PCM byte source consumed by the playback loop
+ */
+typedef struct {
+    const wav_source_ops_t* ops;    /**< Source operations */
+    void* ctx;                      /**< Source specific context */
+    size_t block_size;              /**< Preferred read size in bytes (multiple of block_align), 0 for default */
+} wav_source_t;
+
+/**
+ * @brief Get the error that ended a source's data, see wav_source_ops_t.error
+ * 
+ * @return ESP_OK if the source reached the end of its data or cannot fail
+ */
+static inline esp_err_t wav_source_error(const wav_source_t* source) {
+    return source->ops->error != NULL ? source->ops->error(source->ctx) : ESP_OK;
+}
+
+/**
+ * @brief Cue points of a file, sorted by frame
+ */
+typedef struct {
+    wav_player_cue_t* cues;
+    size_t count;
+} wav_cue_table_t;
+
+/**
+ * @brief Read the cue table from the cue and LIST/adtl chunks of an open file
+ * 
+ * @param fp Open file
+ * @param cue_offset Offset of the cue chunk body
+ * @param cue_size Size of the cue chunk body
+ * @param adtl_offset Offset of the LIST/adtl chunk body, 0 if there is none
+ * @param adtl_size Size of the LIST/adtl chunk body
+ * @param[out] table Cue points, empty if the chunk holds none
+ * @return ESP_OK on success
+ *         ESP_ERR_NO_MEM if the table cannot be allocated
+ */
+esp_err_t wav_cue_table_read(FILE* fp, uint32_t cue_offset, uint32_t cue_size,
+                             uint32_t adtl_offset, uint32_t adtl_size, wav_cue_table_t* table);
+
+/**
+ * @brief Free a table read by wav_cue_table_read()
+ */
+void wav_cue_table_free(wav_cue_table_t* table);
+
+/**
+ * @brief Playback metadata of a WAV file, parsed together with its header
+ */
+typedef struct {
+    bool has_loop;
+    wav_player_loop_t loop;     /**< First loop of the smpl chunk, if has_loop */
+    wav_cue_table_t cues;       /**< Cue points with their adtl labels */
+} wav_file_meta_t;
+
+/**
+ * @brief Parse the RIFF chunks of a WAV file
+ * 
+ * Walks the chunk list, records each chunk, parses the fmt chunk and
+ * validates the format. On success the file is positioned at the start of
+ * the PCM data.
+ * 
+ * @param f File pointer to open WAV file, positioned at the start
+ * @param info Information structure to fill
+ * @param all_chunks Also walk the chunks following the data chunk
+ * @param meta Receives the metadata chunks, found anywhere in the file, NULL
+ *        to stop at the data chunk unless all_chunks is set. Free it with
+ *        wav_file_meta_free(), also on failure.
+ * @return ESP_OK on success
+ *         ESP_ERR_NO_MEM if the cue table cannot be allocated
+ *         ESP_FAIL if the file is not a supported WAV file
+ */
+esp_err_t read_wav_info(FILE* f, wav_player_info_t* info, bool all_chunks, wav_file_meta_t* meta);
+
+/**
+ * @brief Copy metadata, so it can outlive the entry it came from
+ * 
+ * @return ESP_OK on success
+ *         ESP_ERR_NO_MEM if the cue table cannot be allocated
+ */
+esp_err_t wav_file_meta_copy(wav_file_meta_t* dst, const wav_file_meta_t* src);
+
+/**
+ * @brief Free the metadata filled by read_wav_info(), leaving it empty
+ */
+void wav_file_meta_free(wav_file_meta_t* meta);
+
+/**
+ * @brief Parse the fmt chunk body
+ * 
+ * @param body Chunk body
+ * @param size Number of valid bytes in body
+ * @param info Information structure to fill
+ * @return ESP_OK on success
+ *         ESP_FAIL if the chunk is too short
+ */
+esp_err_t parse_fmt_chunk(const uint8_t* body, size_t size, wav_player_info_t* info);
+
+/**
+ * @brief Check the format parsed from the fmt chunk and derive the duration
+ * 
+ * @param info Information with the fmt chunk and data size filled in,
+ *             frame_count and duration_ms are set on success
+ * @return ESP_OK if the format is supported
+ *         ESP_FAIL otherwise
+ */
+esp_err_t validate_wav_info(wav_player_info_t* info);
+
+/**
+ * @brief Validate WAV header format
+ * 
+ * @param header Pointer to WAV header structure
+ * @return true if format is valid and supported
+ */
+bool is_valid_wav_header(const wav_header_t* header);
+
+/**
+ * @brief PCM source reading the data chunk of an open WAV file
+ */
+typedef struct {
+    FILE* fp;                   /**< Open file, positioned at data_offset + pos */
+    uint32_t data_offset;       /**< Offset of the PCM data in the file */
+    uint32_t data_size;         /**< Size of the PCM data, reads stop there */
+    uint32_t pos;               /**< Read position within the PCM data */
+    esp_err_t error;            /**< ESP_FAIL once a read came back short of data_size */
+} wav_file_source_t;
+
+/**
+ * @brief Set up a source reading the PCM data of an open file
+ * 
+ * @param source Source to initialize
+ * @param file File source context, must outlive source
+ * @param fp Open file, positioned at the start of the PCM data
+ * @param info File information from read_wav_info()
+ */
+void wav_file_source_init(wav_source_t* source, wav_file_source_t* file, FILE* fp,
+                          const wav_player_info_t* info);
+
+/**
+ * @brief Stream a PCM source through the write callback
+ * 
+ * Reads the source block by block, converts it to 16-bit stereo with the
+ * current volume applied and hands each block to write_cb. The source is
+ * not closed.
+ * 
+ * @param source PCM source positioned at the first frame to play
+ * @param header Format of the PCM data
+ * @param write_cb Callback function that will receive the audio data
+ * @param user_data User data that will be passed to the callback
+ * @return ESP_OK on successful playback
+ *         ESP_FAIL if buffers cannot be allocated
+ *         Error returned by write_cb otherwise
+ */
+esp_err_t wav_player_play_source(wav_source_t* source, const wav_header_t* header,
+                                 wav_player_write_cb_t write_cb, void* user_data);
+
+/**
+ * @brief One copy of a position, see wav_position_clock_t
+ */
+typedef struct {
+    atomic_uint delivered_lo;
+    atomic_uint delivered_hi;
+    atomic_uint sample_rate;
+} wav_position_slot_t;
+
+/**
+ * @brief Position written by one task and read lock-free by any
+ * 
+ * The writer fills the slot not selected by seq and then increments seq;
+ * readers retry if seq changed while they read. A release fence keeps the
+ * slot stores after the previous seq increment, so a reader that sees the
+ * new data also sees the new seq.
+ */
+typedef struct {
+    atomic_uint seq;
+    wav_position_slot_t slots[2];
+    atomic_uint latency;        /**< Frames still queued in the sink of this playback */
+} wav_position_clock_t;
+
+/**
+ * @brief Update a position clock, from its single writer
+ */
+void wav_position_clock_write(wav_position_clock_t* clock, uint64_t delivered, uint32_t sample_rate);
+
+/**
+ * @brief Read a position clock, applying the reported sink latency
+ * 
+ * @return ESP_OK, or ESP_ERR_INVALID_ARG if pos is NULL
+ */
+esp_err_t wav_position_clock_get(wav_position_clock_t* clock, wav_player_position_t* pos);
+
+/**
+ * @brief Make a new playback the one reported by wav_player_get_position()
+ * 
+ * @return Id to publish the playback's position with
+ */
+uint32_t wav_position_claim(void);
+
+/**
+ * @brief Publish a playback's position if it is still the most recent one
+ */
+void wav_position_publish(uint32_t id, uint64_t delivered, uint32_t sample_rate);
+
+/**
+ * @brief Progress of one playback, dispatching its events
+ */
+typedef struct {
+    uint64_t delivered;         /**< Frames delivered to the sink */
+    wav_position_clock_t clock; /**< delivered, readable from other tasks */
+    uint32_t position_id;       /**< See wav_position_claim() */
+    uint32_t sample_rate;
+    bool concealing;            /**< The last frames delivered were concealment */
+    wav_player_event_cb_t event_cb;
+    void* event_user_data;
+    uint32_t progress_frames;
+    uint64_t next_progress;     /**< delivered at which the next progress event is due */
+    const wav_cue_table_t* cues;
+    size_t next_cue;            /**< Index of the next cue to dispatch */
+    uint64_t next_cue_frame;    /**< Its frame, UINT64_MAX once all cues are dispatched */
+} wav_playback_t;
+
+/**
+ * @brief Start tracking a playback with the current event callback
+ * 
+ * The playback becomes the one reported by wav_player_get_position().
+ */
+void wav_playback_begin(wav_playback_t* pb, const wav_header_t* header);
+
+/**
+ * @brief Whether an event callback is set, so opening a file should parse its cues
+ */
+bool wav_events_enabled(void);
+
+/**
+ * @brief Dispatch cue events of a playback as its delivered frames cross them
+ * 
+ * @param cues Cue table, must outlive the playback, NULL for none
+ */
+void wav_playback_set_cues(wav_playback_t* pb, const wav_cue_table_t* cues);
+
+/**
+ * @brief Count frames the sink accepted, updating the position and dispatching
+ *        start, underrun, cue and progress events
+ * 
+ * @param concealed Whether the frames conceal late data
+ */
+void wav_playback_delivered(wav_playback_t* pb, size_t frames, bool concealed);
+
+/**
+ * @brief Finish a playback, dispatching the end event or the error event if ret is not ESP_OK
+ */
+void wav_playback_end(wav_playback_t* pb, esp_err_t ret);
+
+/**
+ * @brief Destination of converted blocks, a plain, vectored or partial write callback
+ */
+typedef struct {
+    wav_player_write_cb_t write_cb;
+    wav_player_writev_cb_t writev_cb;   /**< Used instead of write_cb when set */
+    wav_player_write_partial_cb_t write_partial_cb; /**< Used instead of write_cb when set */
+    size_t max_blocks;                  /**< Blocks per writev_cb call, 1 otherwise */
+    uint32_t sample_rate;               /**< Paces retries of write_partial_cb, set by wav_play_source_sink() */
+    wav_playback_t* playback;           /**< Progress of the playback, set by wav_play_source_sink() */
+    const wav_cue_table_t* cues;        /**< Cues dispatched during the playback, may be NULL */
+    void* user_data;
+} wav_sink_t;
+
+/**
+ * @brief Append a region to an I/O vector, merging it with an adjacent last region
+ * 
+ * @return New number of regions
+ */
+static inline size_t wav_iov_append(wav_player_iovec_t* iov, size_t iovcnt, const void* data, size_t size) {
+    if (iovcnt > 0 && (const uint8_t*)iov[iovcnt - 1].data + iov[iovcnt - 1].size == data) {
+        iov[iovcnt - 1].size += size;
+        return iovcnt;
+    }
+    iov[iovcnt].data = data;
+    iov[iovcnt].size = size;
+    return iovcnt + 1;
+}
+
+/**
+ * @brief Write regions to a sink, one write_cb call per region unless vectored
+ * 
+ * Partial writes are retried until the sink has taken every region.
+ */
+esp_err_t wav_sink_write(const wav_sink_t* sink, const wav_player_iovec_t* iov, size_t iovcnt);
+
+/**
+ * @brief Stream a PCM source to a sink, see wav_player_play_source()
+ */
+esp_err_t wav_play_source_sink(wav_source_t* source, const wav_header_t* header, const wav_sink_t* sink);
+
+/**
+ * @brief Hash a clip name or path (32-bit FNV-1a)
+ * 
+ * Must match the hash used by the host tools in tools/.
+ * 
+ * @param name NUL terminated name
+ * @return 32-bit hash of name
+ */
+static inline uint32_t wav_player_hash_name(const char* name) {
+    uint32_t hash = 2166136261u;
+    while (*name) {
+        hash ^= (uint8_t)*name++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * @brief Open a WAV file and parse its header
+ * 
+ * @param filepath Path to the WAV file
+ * @param info Information structure to fill
+ * @param all_chunks Also walk the chunks following the data chunk
+ * @return ESP_OK if the file is a supported WAV file
+ *         ESP_FAIL if file cannot be opened or has invalid format
+ */
+esp_err_t wav_player_read_file_info(const char* filepath, wav_player_info_t* info, bool all_chunks);
+
+/** Maximum path length handled by the directory walker */
+#define WAV_PLAYER_MAX_PATH 256
+
+/**
+ * @brief Callback invoked by wav_player_walk_dir() for each .wav file
+ * 
+ * @return ESP_OK to continue walking, any other value stops the walk
+ */
+typedef esp_err_t (*wav_player_walk_cb_t)(const char* path, void* ctx);
+
+/**
+ * @brief Call cb for every .wav file below dir
+ * 
+ * @param dir Directory to walk, paths are built as "<dir>/<relative path>"
+ * @param cb Callback receiving each path
+ * @param ctx Context passed to cb
+ * @return ESP_OK on success, ESP_FAIL if dir cannot be opened, or the error returned by cb
+ */
+esp_err_t wav_player_walk_dir(const char* dir, wav_player_walk_cb_t cb, void* ctx);
+
+/** Core affinity value for threads that may run on any core */
+#define WAV_PLAYER_CORE_ANY (-1)
+
+/**
+ * @brief Start a worker thread
+ * 
+ * On the ESP32 the thread is a FreeRTOS task created through esp_pthread so
+ * it can be pinned to a core, on the Linux host it is a plain pthread.
+ * 
+ * @param thread Thread handle to fill
+ * @param fn Thread function
+ * @param arg Argument passed to fn
+ * @param name Thread name
+ * @param core_id Core to pin the thread to, or WAV_PLAYER_CORE_ANY
+ * @param stack_size Stack size in bytes
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if the thread cannot be created
+ */
+esp_err_t wav_player_thread_create(pthread_t* thread, void* (*fn)(void*), void* arg,
+                                   const char* name, int core_id, size_t stack_size);
+
+/**
+ * @brief Get the number of cores available to worker threads
+ */
+size_t wav_player_num_cores(void);
+
+/**
+ * @brief Open file handed out by the file handle pool
+ */
+typedef struct {
+    FILE* fp;                   /**< Open file, positioned at the start of the PCM data */
+    wav_player_info_t info;     /**< Parsed header of the file */
+    wav_file_meta_t meta;       /**< Metadata of the file */
+    char* path;                 /**< Path the file was opened with */
+    uint32_t path_hash;         /**< Hash of path */
+    uint32_t last_used;         /**< LRU stamp */
+    bool in_use;                /**< Handle is lent out to a playback */
+    bool pooled;                /**< Entry lives in the pool, otherwise it is closed on release */
+} wav_pool_entry_t;
+
+/**
+ * @brief Get an open, parsed file from the handle pool
+ * 
+ * Opens and parses the file on a miss. If every pooled handle is busy the
+ * file is handed out in a temporary entry that is closed on release.
+ * 
+ * The entry keeps the file's metadata, see read_wav_info().
+ * 
+ * @param filepath Path of the file
+ * @param[out] out_entry Entry positioned at the start of the PCM data, or
+ *             NULL if the pool is disabled
+ * @return ESP_OK on success (including a disabled pool)
+ *         ESP_ERR_NO_MEM if the entry or its cue table cannot be allocated
+ *         ESP_FAIL if file cannot be opened or has invalid format
+ */
+esp_err_t wav_pool_acquire(const char* filepath, wav_pool_entry_t** out_entry);
+
+/**
+ * @brief Get a file from the handle pool only if it is already open there
+ * 
+ * Never touches storage beyond a seek, for callers that know the layout of
+ * the file already.
+ * 
+ * @param filepath Path of the file
+ * @return Entry positioned at the start of the PCM data, NULL on a miss
+ */
+wav_pool_entry_t* wav_pool_acquire_cached(const char* filepath);
+
+/**
+ * @brief Return an entry obtained from wav_pool_acquire() or wav_pool_acquire_cached()
+ * 
+ * @param entry Entry to return
+ * @param keep false to close the file, e.g. after an I/O error
+ */
+void wav_pool_release(wav_pool_entry_t* entry, bool keep);
+
+/**
+ * @brief Open a source serving a prefetched file
+ * 
+ * The source plays the cached head from RAM and continues from storage once
+ * the head is consumed. The file is opened and positioned past the head here,
+ * so reads past the head only cost a fread. Release it with
+ * source->ops->close(source->ctx).
+ * 
+ * @param filepath Path of the file
+ * @param[out] source Source to initialize
+ * @param[out] info Cached information of the file
+ * @param[out] meta Cached metadata of the file, valid until the source is closed
+ * @return ESP_OK if the file is cached
+ *         ESP_ERR_NOT_FOUND if it is not (or prefetching is disabled)
+ *         ESP_ERR_NO_MEM if the source cannot be allocated
+ *         ESP_FAIL if the rest of the file cannot be opened
+ */
+esp_err_t wav_prefetch_open(const char* filepath, wav_source_t* source, wav_player_info_t* info,
+                            const wav_file_meta_t** meta);
+
+/**
+ * @brief Route a source through the read scheduler
+ * 
+ * @param inner Source to read from in the I/O task, must outlive scheduled
+ * @param header Format of the PCM data, sets the stream's consumption rate
+ * @param[out] scheduled Source reading from the stream's read-ahead buffer,
+ *             release it with scheduled->ops->close(scheduled->ctx)
+ * @return ESP_OK if the source is scheduled
+ *         ESP_ERR_INVALID_STATE if the scheduler is not running or full
+ *         ESP_ERR_NO_MEM if the stream cannot be allocated
+ */
+esp_err_t wav_sched_attach(wav_source_t* inner, const wav_header_t* header, wav_source_t* scheduled);
+
+/**
+ * @brief Check whether a scheduled source ran out of data in time
+ * 
+ * A read of a scheduled source returns 0 both at the end of the data and
+ * when underrun_timeout_ms passed without data. This tells the two apart
+ * and clears the underrun.
+ * 
+ * @param scheduled Source set up by wav_sched_attach()
+ * @param[out] policy Concealment to apply when an underrun is reported
+ * @return true if the last read returned 0 because the data was late
+ */
+bool wav_sched_take_underrun(const wav_source_t* scheduled, wav_player_underrun_policy_t* policy);
+
+/**
+ * @brief Histogram bucket of a latency, see wav_player_latency_hist_t
+ */
+static inline int wav_latency_bucket(uint64_t latency_us) {
+    int bucket = 0;
+    while (bucket < WAV_PLAYER_LATENCY_BUCKETS - 1 && (latency_us >> (bucket + 1)) > 0) {
+        bucket++;
+    }
+    return bucket;
+}
+
+/**
+ * @brief Percentile of WAV_PLAYER_LATENCY_BUCKETS log2 buckets
+ * 
+ * @return Upper edge of the bucket holding the percentile in us, 0 if empty
+ */
+uint32_t wav_latency_percentile(const uint32_t* buckets, uint32_t percent);
+
+/**
+ * @brief Add the timing of one played block to the latency statistics
+ * 
+ * @param budget_us Real-time duration of the block
+ */
+void wav_stats_record_block(uint32_t read_us, uint32_t convert_us, uint32_t write_us, uint32_t budget_us);
+
+/**
+ * @brief Convert a block of PCM frames to 16-bit stereo
+ * 
+ * Converts 16-bit or 24-bit mono/stereo frames to interleaved 16-bit stereo,
+ * duplicating mono samples to both channels and applying the volume.
+ * 
+ * @param header WAV format of the input frames
+ * @param in Input PCM data
+ * @param in_bytes Size of input data in bytes, trailing partial frames are ignored
+ * @param out Output buffer, must hold (in_bytes / block_align) * 2 samples
+ * @param volume Volume level (0-100)
+ * @return Number of bytes written to out
+ */
+size_t wav_convert_block(const wav_header_t* header, const uint8_t* in, size_t in_bytes,
+                         int16_t* out, int volume);
+
+/**
+ * @brief Scale 16-bit stereo frames by a linear ramp, fading out or in
+ */
+void wav_fade_block(int16_t* samples, size_t frames, bool fade_in);
+
+/**
+ * @brief Fill a 16-bit stereo block standing in for late data
+ * 
+ * @param out Receives the concealment block, may equal last
+ * @param last The last block written
+ * @param last_frames Frames of the last block written, 0 if none
+ * @param block_frames Frames in a regular block
+ * @param concealed Whether the last block written was already a concealment block
+ * @param policy WAV_PLAYER_UNDERRUN_FADE or WAV_PLAYER_UNDERRUN_REPEAT
+ * @return Frames in the concealment block
+ */
+size_t wav_conceal_block(int16_t* out, const int16_t* last, size_t last_frames,
+                         size_t block_frames, bool concealed, wav_player_underrun_policy_t policy);
+
+/**
+ * @brief Play a source through the dual-core pipeline
+ * 
+ * @param source Source to play
+ * @param is_scheduled Whether source was set up by wav_sched_attach()
+ * @param header Format of the PCM data
+ * @param block_frames Frames per block
+ * @param sink Destination of the converted blocks
+ * @return ESP_OK when playback completed
+ *         ESP_ERR_NOT_SUPPORTED if the pipeline is disabled or cannot start,
+ *         the source has not been read and can be played serially
+ *         Error from the write callback otherwise
+ */
+esp_err_t wav_pipeline_play(wav_source_t* source, bool is_scheduled, const wav_header_t* header,
+                            size_t block_frames, const wav_sink_t* sink);
+
+/**
+ * @brief Effect chain of one playback
+ */
+typedef struct {
+    wav_player_fx_t fx[WAV_PLAYER_FX_MAX];  /**< ctx replaced by the state from create */
+    size_t count;
+} wav_fx_chain_t;
+
+/**
+ * @brief Copy the current effect chain for a playback, creating its effect state
+ *
+ * @return ESP_OK on success
+ *         ESP_ERR_NO_MEM if an effect cannot create its state
+ */
+esp_err_t wav_fx_chain_create(wav_fx_chain_t* chain);
+
+/**
+ * @brief Destroy the effect state of a playback
+ */
+void wav_fx_chain_free(wav_fx_chain_t* chain);
+
+/**
+ * @brief Clear the effect state of a playback
+ */
+void wav_fx_chain_reset(wav_fx_chain_t* chain);
+
+/**
+ * @brief Run the effect chain of a playback over a converted 16-bit stereo block
+ */
+void wav_fx_process(wav_fx_chain_t* chain, int16_t* samples, size_t frames);
+
+/**
+ * @brief Frames per block when playing a source
+ */
+size_t wav_block_frames(const wav_source_t* source, const wav_header_t* header);
+
+/**
+ * @brief Block-wise reader producing converted 16-bit stereo blocks
+ * 
+ * Shared by push and pull playback: reads a block from the source,
+ * converts it, applies the volume and effect chain, and stands in
+ * concealment blocks when a scheduled source is late.
+ */
+typedef struct {
+    wav_source_t* source;
+    bool is_scheduled;          /**< Source was set up by wav_sched_attach() */
+    const wav_header_t* header;
+    size_t block_frames;
+    uint8_t* raw;               /**< One block of source frames */
+    int16_t* out;               /**< Slot receiving the next block, holds the last block produced */
+    int16_t* out_mem;           /**< out_blocks output slots */
+    size_t out_blocks;
+    size_t out_slot;            /**< Index of out in out_mem */
+    const int16_t* last;        /**< Last converted block, repeated to conceal late data */
+    size_t last_frames;         /**< Frames of the last converted block */
+    bool concealed;             /**< The last block was a concealment block */
+    wav_fx_chain_t fx;          /**< Effect chain of this playback */
+} wav_block_reader_t;
+
+/**
+ * @brief Allocate the buffers of a block reader
+ * 
+ * @param out_blocks Number of output slots, so that several blocks can be
+ *        produced before they are written, see wav_block_reader_advance()
+ * @return ESP_OK on success
+ *         ESP_ERR_NO_MEM if the buffers or the effect state cannot be allocated
+ */
+esp_err_t wav_block_reader_init(wav_block_reader_t* reader, wav_source_t* source, bool is_scheduled,
+                                const wav_header_t* header, size_t block_frames, size_t out_blocks);
+
+/**
+ * @brief Move reader->out to the next output slot, keeping the last block intact
+ */
+void wav_block_reader_advance(wav_block_reader_t* reader);
+
+/**
+ * @brief Free the buffers of a block reader
+ */
+void wav_block_reader_free(wav_block_reader_t* reader);
+
+/**
+ * @brief Produce the next block into reader->out
+ * 
+ * @param[out] read_us Time spent reading, set for converted blocks
+ * @param[out] convert_us Time spent converting, set for converted blocks
+ * @param[out] concealed Whether the block conceals late data
+ * @return Frames in reader->out, 0 at the end of the source
+ */
+size_t wav_block_reader_next(wav_block_reader_t* reader, uint32_t* read_us, uint32_t* convert_us,
+                             bool* concealed);
+
+/**
+ * @brief A WAV file opened for playback
+ * 
+ * Served from the prefetch cache, the file handle pool or a fresh fopen,
+ * in that order.
+ */
+typedef struct {
+    wav_player_info_t info;
+    const wav_file_meta_t* meta; /**< Metadata, from the cache entry or own_meta */
+    wav_file_meta_t own_meta;   /**< Metadata of a file opened by wav_open_file() */
+    wav_source_t source;        /**< Positioned at the first frame */
+    wav_file_source_t file;     /**< Context of source unless prefetched */
+    FILE* fp;                   /**< Opened by wav_open_file(), NULL if pooled or prefetched */
+    wav_pool_entry_t* pooled;
+    bool prefetched;
+} wav_open_file_t;
+
+/**
+ * @brief Open a WAV file for playback
+ * 
+ * Cached files come with their metadata. A file opened from storage has it
+ * parsed from the same handle when with_meta is set, which walks the chunks
+ * past the data chunk; otherwise file->meta is empty.
+ * 
+ * @param filepath Path to the WAV file
+ * @param with_meta Parse the metadata of a file that is not cached
+ * @param[out] file Opened file, must not move until wav_close_file()
+ * @return ESP_OK on success
+ *         ESP_ERR_NO_MEM if the file's entry or cue table cannot be allocated
+ *         ESP_FAIL if the file cannot be opened or has an invalid format
+ */
+esp_err_t wav_open_file(const char* filepath, bool with_meta, wav_open_file_t* file);
+
+/**
+ * @brief Release a file opened by wav_open_file()
+ */
+void wav_close_file(wav_open_file_t* file);
+
+/**
+ * @brief Wrap a source to repeat a loop region
+ * 
+ * Buffers the start of the loop and rewinds inner to the first frame.
+ * Release the source with looped->ops->close(looped->ctx), inner is not closed.
+ * 
+ * @param inner Source positioned at the first frame, must support seeking and outlive looped
+ * @param info Information of the data read by inner
+ * @param loop Loop region
+ * @param[out] looped Source playing the data with the loop repeated
+ * @return ESP_OK on success
+ *         ESP_ERR_INVALID_ARG if the loop region is empty or beyond the data
+ *         ESP_ERR_NOT_SUPPORTED if inner cannot seek
+ *         ESP_ERR_NO_MEM if the loop buffer cannot be allocated
+ *         ESP_FAIL if the loop start cannot be read
+ */
+esp_err_t wav_loop_source_create(wav_source_t* inner, const wav_player_info_t* info,
+                                 const wav_player_loop_t* loop, wav_source_t* looped);
+
+/**
+ * @brief Read the first loop of a smpl chunk
+ * 
+ * @param fp Open file
+ * @param offset Offset of the chunk body
+ * @param size Size of the chunk body
+ * @param[out] loop Loop region, with the end converted to an exclusive end
+ * @return ESP_OK on success
+ *         ESP_ERR_NOT_FOUND if the chunk holds no loop
+ */
+esp_err_t wav_loop_read_smpl(FILE* fp, uint32_t offset, uint32_t size, wav_player_loop_t* loop);
+
+/**
+ * @brief Open a player handle, optionally looping
+ * 
+ * @param looping Repeat a loop region
+ * @param loop Loop region, NULL for the one in the file's smpl chunk
+ * @return See wav_player_open_loop()
+ */
+esp_err_t wav_handle_open(const char* filepath, bool looping, const wav_player_loop_t* loop,
+                          wav_player_handle_t* handle);
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "sdkconfig.h"
+#include "wav_player_trace.h"
+
+#if CONFIG_WAV_PLAYER_TRACE
+
+void wav_trace_record(wav_player_trace_event_t event, uint32_t arg);
+
+#define WAV_TRACE(event, arg) wav_trace_record((event), (uint32_t)(arg))
+
+#else
+
+// Arguments are not evaluated, disabled trace points cost nothing
+#define WAV_TRACE(event, arg) do {} while (0)
+
+#endif
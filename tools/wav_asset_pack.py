@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+"""Build a WAV asset pack ("WPAK") for wav_player.
+
+Stores the PCM data of many WAV files in one file behind a directory of name
+hashes, offsets, pre-parsed formats and clip names, so the player keeps a single file
+handle open and seeks straight to a clip. See include/wav_player_pack.h for the
+layout.
+
+Clip names are the file paths relative to the given base directory, e.g.
+"prompts/hello.wav".
+
+Usage: wav_asset_pack.py output.wpak input.wav|dir... [--base DIR] [--align N]
+"""
+
+import argparse
+import os
+import struct
+import sys
+
+from wav_lz4_pack import read_wav
+
+MAGIC = b"WPAK"
+VERSION = 2
+HEADER_SIZE = 12
+ENTRY_SIZE = 28
+MAX_NAME = 256  # must match PACK_MAX_NAME in wav_player_pack.c
+
+
+def fnv1a32(name):
+    """Clip name hash, must match wav_player_hash_name()."""
+    h = 2166136261
+    for b in name.encode("utf-8"):
+        h ^= b
+        h = (h * 16777619) & 0xFFFFFFFF
+    return h
+
+
+def collect(inputs, base):
+    files = []
+    for path in inputs:
+        if os.path.isdir(path):
+            for root, _, names in os.walk(path):
+                for name in sorted(names):
+                    if name.lower().endswith(".wav"):
+                        files.append(os.path.join(root, name))
+        else:
+            files.append(path)
+    return [(os.path.relpath(f, base).replace(os.sep, "/"), f) for f in sorted(files)]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("output", help="output pack file")
+    parser.add_argument("inputs", nargs="+", help="WAV files or directories")
+    parser.add_argument("--base", default=".", help="directory clip names are relative to")
+    parser.add_argument("--align", type=int, default=512,
+                        help="alignment of clip data in bytes, 512 matches SD sectors (default: 512)")
+    args = parser.parse_args()
+    if args.align < 1:
+        parser.error("--align must be at least 1, got %d" % args.align)
+
+    clips = collect(args.inputs, args.base)
+    if len(clips) > 0xFFFF:
+        sys.exit("too many clips: %d" % len(clips))
+
+    entries = []
+    seen = {}
+    for name, path in clips:
+        h = fnv1a32(name)
+        if h in seen:
+            sys.exit("hash collision between %s and %s, rename one" % (seen[h], name))
+        seen[h] = name
+        channels, rate, bits, block_align, pcm = read_wav(path)
+        if bits not in (16, 24) or channels not in (1, 2):
+            sys.exit("%s: unsupported format (%d ch, %d bit)" % (path, channels, bits))
+        entries.append((h, name, channels, rate, bits, block_align, pcm))
+    entries.sort(key=lambda e: e[0])
+
+    names = bytearray()
+    name_offsets = []
+    for entry in entries:
+        encoded = entry[1].encode("utf-8") + b"\0"
+        if len(encoded) > MAX_NAME:
+            sys.exit("clip name too long: %s" % entry[1])
+        name_offsets.append(len(names))
+        names += encoded
+
+    offset = HEADER_SIZE + ENTRY_SIZE * len(entries) + len(names)
+    directory = bytearray()
+    data = bytearray()
+    for (h, name, channels, rate, bits, block_align, pcm), name_offset in zip(entries, name_offsets):
+        pad = -offset % args.align
+        data += b"\0" * pad
+        offset += pad
+        directory += struct.pack("<IIIIHHHHI", h, offset, len(pcm), rate,
+                                 channels, bits, block_align, 0, name_offset)
+        data += pcm
+        offset += len(pcm)
+
+    with open(args.output, "wb") as f:
+        f.write(MAGIC + struct.pack("<HHI", VERSION, len(entries), len(names)))
+        f.write(directory)
+        f.write(names)
+        f.write(data)
+
+    print("%s: %d clips, %d bytes" % (args.output, len(entries), offset))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,147 @@
+#!/usr/bin/env python3
+"""Convert a PCM WAV file into an LZ4 PCM container ("WLZ4") for wav_player.
+
+The PCM data is split into fixed size blocks which are LZ4-compressed
+independently, so the player can decompress block by block and seek through
+the block offset table. See include/wav_player_lz4.h for the layout.
+
+Usage: wav_lz4_pack.py input.wav output.wlz4 [--block-frames N]
+"""
+
+import argparse
+import struct
+import sys
+
+MAGIC = b"WLZ4"
+VERSION = 1
+HEADER_SIZE = 28
+
+MIN_MATCH = 4
+LAST_LITERALS = 5
+MF_LIMIT = 12
+MAX_OFFSET = 65535
+
+
+def read_wav(path):
+    """Return (channels, sample_rate, bits, block_align, pcm_bytes)."""
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[0:4] != b"RIFF" or data[8:12] != b"WAVE":
+        raise ValueError("%s: not a RIFF/WAVE file" % path)
+
+    fmt = None
+    pcm = None
+    pos = 12
+    while pos + 8 <= len(data):
+        chunk_id = data[pos:pos + 4]
+        chunk_size = struct.unpack_from("<I", data, pos + 4)[0]
+        body = pos + 8
+        if chunk_id == b"fmt ":
+            fmt = struct.unpack_from("<HHIIHH", data, body)
+        elif chunk_id == b"data":
+            pcm = data[body:body + chunk_size]
+        pos = body + chunk_size + (chunk_size & 1)
+
+    if fmt is None or pcm is None:
+        raise ValueError("%s: missing fmt or data chunk" % path)
+    _, channels, sample_rate, _, block_align, bits = fmt
+    pcm = pcm[:len(pcm) - len(pcm) % block_align]
+    return channels, sample_rate, bits, block_align, pcm
+
+
+def _length_bytes(n):
+    out = bytearray()
+    while n >= 255:
+        out.append(255)
+        n -= 255
+    out.append(n)
+    return out
+
+
+def _emit(out, literals, offset=None, match_len=0):
+    lit_len = len(literals)
+    token = min(lit_len, 15) << 4
+    if offset is not None:
+        token |= min(match_len - MIN_MATCH, 15)
+    out.append(token)
+    if lit_len >= 15:
+        out += _length_bytes(lit_len - 15)
+    out += literals
+    if offset is not None:
+        out += struct.pack("<H", offset)
+        if match_len - MIN_MATCH >= 15:
+            out += _length_bytes(match_len - MIN_MATCH - 15)
+
+
+def lz4_compress_block(data):
+    """Greedy LZ4 block compressor, output is decodable by any LZ4 decoder."""
+    n = len(data)
+    out = bytearray()
+    table = {}
+    anchor = 0
+    i = 0
+    limit = n - MF_LIMIT
+    while i < limit:
+        key = data[i:i + MIN_MATCH]
+        candidate = table.get(key)
+        table[key] = i
+        if candidate is not None and i - candidate <= MAX_OFFSET:
+            max_len = n - LAST_LITERALS - i
+            length = MIN_MATCH
+            while length < max_len and data[candidate + length] == data[i + length]:
+                length += 1
+            _emit(out, data[anchor:i], i - candidate, length)
+            i += length
+            anchor = i
+            continue
+        i += 1
+    _emit(out, data[anchor:])
+    return bytes(out)
+
+
+def pack(channels, sample_rate, bits, block_align, pcm, block_frames):
+    block_size = block_frames * block_align
+    block_count = (len(pcm) + block_size - 1) // block_size
+
+    blocks = []
+    for index in range(block_count):
+        raw = pcm[index * block_size:(index + 1) * block_size]
+        packed = lz4_compress_block(raw)
+        # A block whose stored size equals its raw size is stored uncompressed
+        blocks.append(packed if len(packed) < len(raw) else raw)
+
+    offsets = []
+    offset = HEADER_SIZE + 4 * (block_count + 1)
+    for block in blocks:
+        offsets.append(offset)
+        offset += len(block)
+    offsets.append(offset)
+
+    header = MAGIC + struct.pack("<HHIHHIII", VERSION, channels, sample_rate, bits,
+                                 block_align, len(pcm), block_size, block_count)
+    table = struct.pack("<%dI" % len(offsets), *offsets)
+    return header + table + b"".join(blocks)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("input", help="source WAV file")
+    parser.add_argument("output", help="output container file")
+    parser.add_argument("--block-frames", type=int, default=1024,
+                        help="frames per compressed block (default: 1024)")
+    args = parser.parse_args()
+
+    channels, sample_rate, bits, block_align, pcm = read_wav(args.input)
+    if bits not in (16, 24) or channels not in (1, 2):
+        sys.exit("%s: unsupported format (%d ch, %d bit)" % (args.input, channels, bits))
+
+    container = pack(channels, sample_rate, bits, block_align, pcm, args.block_frames)
+    with open(args.output, "wb") as f:
+        f.write(container)
+
+    ratio = 100.0 * len(container) / max(len(pcm), 1)
+    print("%s: %d bytes PCM -> %d bytes (%.1f%%)" % (args.output, len(pcm), len(container), ratio))
+
+
+if __name__ == "__main__":
+    main()
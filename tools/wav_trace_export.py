@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+"""Convert a wav_player trace file to a Chrome / Perfetto JSON trace.
+
+Reads the file written by wav_player_trace_save() (see
+include/wav_player_trace.h) and writes the Trace Event Format understood by
+chrome://tracing and ui.perfetto.dev. Each recording task becomes a thread
+track, _BEGIN/_END events become spans and the remaining events instant
+markers, so overlap between reading, converting and writing is visible.
+
+Usage: wav_trace_export.py trace.bin [-o trace.json]
+"""
+
+import argparse
+import json
+import struct
+import sys
+
+MAGIC = b"WTRC"
+VERSION = 1
+HEADER_SIZE = 16
+RECORD = struct.Struct("<qIHH")
+
+# Must match wav_player_trace_event_t
+EVENTS = [
+    "play_begin", "play_end",
+    "read_begin", "read_end",
+    "convert_begin", "convert_end",
+    "write_begin", "write_end",
+    "underrun",
+    "sched_read_begin", "sched_read_end",
+    "sched_burst",
+    "sched_resize",
+]
+
+
+def load(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if len(data) < HEADER_SIZE or data[:4] != MAGIC:
+        sys.exit("%s: not a wav_player trace" % path)
+    version, count, record_size = struct.unpack_from("<III", data, 4)
+    if version != VERSION or record_size != RECORD.size:
+        sys.exit("%s: unsupported trace version %d / record size %d" % (path, version, record_size))
+    if len(data) < HEADER_SIZE + count * RECORD.size:
+        sys.exit("%s: truncated" % path)
+    return [RECORD.unpack_from(data, HEADER_SIZE + i * RECORD.size) for i in range(count)]
+
+
+def convert(records):
+    events = []
+    open_spans = {}
+    tasks = set()
+    for time_us, arg, event, task in records:
+        name = EVENTS[event] if event < len(EVENTS) else "event_%d" % event
+        tasks.add(task)
+        base = {"pid": 1, "tid": task, "ts": time_us}
+        if name.endswith("_begin"):
+            span = name[:-len("_begin")]
+            open_spans[(task, span)] = True
+            events.append(dict(base, name=span, ph="B"))
+        elif name.endswith("_end"):
+            span = name[:-len("_end")]
+            # The ring may have dropped the matching begin
+            if open_spans.pop((task, span), False):
+                events.append(dict(base, name=span, ph="E", args={"arg": arg}))
+        else:
+            events.append(dict(base, name=name, ph="i", s="t", args={"arg": arg}))
+
+    for task in sorted(tasks):
+        events.append({"pid": 1, "tid": task, "ph": "M", "name": "thread_name",
+                       "args": {"name": "task %d" % task}})
+    return {"traceEvents": events, "displayTimeUnit": "ms"}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("input", help="trace file from wav_player_trace_save()")
+    parser.add_argument("-o", "--output", help="output JSON file (default: input with .json)")
+    args = parser.parse_args()
+
+    records = load(args.input)
+    output = args.output or args.input.rsplit(".", 1)[0] + ".json"
+    with open(output, "w") as f:
+        json.dump(convert(records), f)
+
+    print("%s: %d events" % (output, len(records)))
+
+
+if __name__ == "__main__":
+    main()
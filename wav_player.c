@@ -1,6 +1,12 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include "wav_player.h"
+#include "wav_player_priv.h"
+#include "wav_player_trace_priv.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include <string.h>
 
 static const char *TAG = "wav_player";
@@ -53,7 +59,7 @@ static inline int16_t apply_volume(int16_t sample, int volume) {
  * @return true if format is valid and supported
  *         false if format is invalid or unsupported
  */
-static bool is_valid_wav_header(const wav_header_t* header) {
+bool is_valid_wav_header(const wav_header_t* header) {
     if (header->num_channels < 1 || header->num_channels > 2) {
         ESP_LOGE(TAG, "Unsupported number of channels: %d", header->num_channels);
         return false;
@@ -79,135 +85,738 @@ static bool is_valid_wav_header(const wav_header_t* header) {
     return true;
 }
 
-/**
- * @brief Read WAV file header
- * 
- * Reads and parses the WAV file header into the header structure.
- * 
- * @param f File pointer to open WAV file
- * @param header Pointer to header structure to fill
- * @return ESP_OK on successful read
- *         ESP_FAIL if read fails
- */
-static esp_err_t read_wav_header(FILE* f, wav_header_t* header) {
-    uint8_t wav_header[44];
-    
-    if (fread(wav_header, 1, 44, f) != 44) {
+esp_err_t parse_fmt_chunk(const uint8_t* body, size_t size, wav_player_info_t* info) {
+    if (size < 16) {
+        ESP_LOGE(TAG, "fmt chunk too short: %u", (unsigned)size);
+        return ESP_FAIL;
+    }
+
+    info->format_tag = read_le16(&body[0]);
+    info->header.num_channels = read_le16(&body[2]);
+    info->header.sample_rate = read_le32(&body[4]);
+    info->header.block_align = read_le16(&body[12]);
+    info->header.bits_per_sample = read_le16(&body[14]);
+
+    // WAVE_FORMAT_EXTENSIBLE stores the real format tag at the start of the sub-format GUID
+    if (info->format_tag == WAV_FORMAT_EXTENSIBLE && size >= 26) {
+        info->format_tag = read_le16(&body[24]);
+    }
+    return ESP_OK;
+}
+
+esp_err_t validate_wav_info(wav_player_info_t* info) {
+    if (info->format_tag != WAV_FORMAT_PCM) {
+        ESP_LOGE(TAG, "Unsupported format tag: 0x%04x", info->format_tag);
+        return ESP_FAIL;
+    }
+    if (!is_valid_wav_header(&info->header)) {
+        return ESP_FAIL;
+    }
+
+    info->frame_count = info->header.data_size / info->header.block_align;
+    info->duration_ms = (uint32_t)((uint64_t)info->frame_count * 1000 / info->header.sample_rate);
+    return ESP_OK;
+}
+
+esp_err_t read_wav_info(FILE* f, wav_player_info_t* info, bool all_chunks, wav_file_meta_t* meta) {
+    uint8_t riff[12];
+
+    memset(info, 0, sizeof(*info));
+    if (meta != NULL) {
+        memset(meta, 0, sizeof(*meta));
+    }
+
+    if (fread(riff, 1, sizeof(riff), f) != sizeof(riff)) {
         ESP_LOGE(TAG, "Failed to read WAV header");
         return ESP_FAIL;
     }
+    if (memcmp(riff, "RIFF", 4) != 0 || memcmp(&riff[8], "WAVE", 4) != 0) {
+        ESP_LOGE(TAG, "Not a RIFF/WAVE file");
+        return ESP_FAIL;
+    }
+
+    // Chunks must end within the RIFF chunk and the file, streaming writers may leave the RIFF size 0.
+    // fstat() reads the size from the directory entry, unlike seeking to the end of the file.
+    uint64_t end = UINT64_MAX;
+    struct stat st;
+    if (fstat(fileno(f), &st) == 0 && st.st_size > 0) {
+        end = (uint64_t)st.st_size;
+    }
+    uint64_t riff_end = (uint64_t)read_le32(&riff[4]) + 8;
+    if (riff_end >= sizeof(riff) && riff_end < end) {
+        end = riff_end;
+    }
+    if (fseek(f, sizeof(riff), SEEK_SET) != 0) {
+        ESP_LOGE(TAG, "Failed to seek to first chunk");
+        return ESP_FAIL;
+    }
 
-    header->num_channels = wav_header[22] | (wav_header[23] << 8);
-    header->sample_rate = wav_header[24] | (wav_header[25] << 8) | 
-                         (wav_header[26] << 16) | (wav_header[27] << 24);
-    header->bits_per_sample = wav_header[34] | (wav_header[35] << 8);
-    header->block_align = wav_header[32] | (wav_header[33] << 8);
-    header->data_size = wav_header[40] | (wav_header[41] << 8) | 
-                       (wav_header[42] << 16) | (wav_header[43] << 24);
+    bool has_fmt = false;
+    bool has_data = false;
+    uint64_t offset = sizeof(riff);
+    uint32_t smpl_offset = 0, smpl_size = 0;
+    uint32_t cue_offset = 0, cue_size = 0;
+    uint32_t adtl_offset = 0, adtl_size = 0;
 
+    while (offset + 8 <= end) {
+        uint8_t chunk[8];
+        if (fread(chunk, 1, sizeof(chunk), f) != sizeof(chunk)) {
+            break;
+        }
+
+        uint32_t size = read_le32(&chunk[4]);
+        uint64_t body_offset = offset + sizeof(chunk);
+        bool is_data = memcmp(chunk, "data", 4) == 0;
+
+        // A truncated data chunk still plays, reads report where it ends
+        if (body_offset + size > end && !is_data) {
+            // Broken trailing metadata must not keep a playable file from playing
+            if (has_data) {
+                ESP_LOGW(TAG, "Chunk %.4s at %lu overruns the file, ignoring the rest",
+                         (const char*)chunk, (uint32_t)offset);
+                break;
+            }
+            ESP_LOGE(TAG, "Chunk %.4s at %lu overruns the file", (const char*)chunk, (uint32_t)offset);
+            return ESP_FAIL;
+        }
+
+        if (info->chunk_count < WAV_PLAYER_MAX_CHUNKS) {
+            wav_chunk_info_t *entry = &info->chunks[info->chunk_count++];
+            memcpy(entry->id, chunk, 4);
+            entry->offset = body_offset;
+            entry->size = size;
+        }
+
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            uint8_t body[40];
+            size_t body_len = size < sizeof(body) ? size : sizeof(body);
+            if (fread(body, 1, body_len, f) != body_len ||
+                parse_fmt_chunk(body, body_len, info) != ESP_OK) {
+                return ESP_FAIL;
+            }
+            has_fmt = true;
+        } else if (is_data) {
+            info->data_offset = body_offset;
+            info->header.data_size = size;
+            has_data = true;
+            // Metadata chunks usually follow the data
+            if (!all_chunks && meta == NULL) {
+                break;
+            }
+        } else if (meta != NULL && memcmp(chunk, "smpl", 4) == 0 && smpl_offset == 0) {
+            smpl_offset = body_offset;
+            smpl_size = size;
+        } else if (meta != NULL && memcmp(chunk, "cue ", 4) == 0 && cue_offset == 0) {
+            cue_offset = body_offset;
+            cue_size = size;
+        } else if (meta != NULL && memcmp(chunk, "LIST", 4) == 0 && adtl_offset == 0) {
+            // Labels may precede the cue chunk, so both are parsed after the walk
+            uint8_t list_type[4];
+            if (size >= sizeof(list_type) &&
+                fread(list_type, 1, sizeof(list_type), f) == sizeof(list_type) &&
+                memcmp(list_type, "adtl", 4) == 0) {
+                adtl_offset = body_offset;
+                adtl_size = size;
+            }
+        }
+
+        // Chunk bodies are padded to an even size, computed in 64 bits so no size can wrap back
+        uint64_t next = body_offset + size + (size & 1);
+        if (next <= offset) {
+            ESP_LOGE(TAG, "Invalid chunk size %lu", size);
+            return ESP_FAIL;
+        }
+        offset = next;
+        if (offset >= end || fseek(f, offset, SEEK_SET) != 0) {
+            break;
+        }
+    }
+
+    if (!has_fmt || !has_data) {
+        ESP_LOGE(TAG, "Missing %s chunk", has_fmt ? "data" : "fmt");
+        return ESP_FAIL;
+    }
+    if (validate_wav_info(info) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    if (smpl_offset != 0) {
+        meta->has_loop = wav_loop_read_smpl(f, smpl_offset, smpl_size, &meta->loop) == ESP_OK;
+    }
+    if (cue_offset != 0 &&
+        wav_cue_table_read(f, cue_offset, cue_size, adtl_offset, adtl_size, &meta->cues) != ESP_OK) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (fseek(f, info->data_offset, SEEK_SET) != 0) {
+        ESP_LOGE(TAG, "Failed to seek to data");
+        return ESP_FAIL;
+    }
     return ESP_OK;
 }
 
-esp_err_t wav_player_get_info(const char* filepath, wav_header_t* header) {
+size_t wav_convert_block(const wav_header_t* header, const uint8_t* in, size_t in_bytes,
+                         int16_t* out, int volume) {
+    size_t frames = in_bytes / header->block_align;
+
+    if (header->bits_per_sample == 16) {
+        const int16_t *samples = (const int16_t*)in;
+
+        if (header->num_channels == 1) {
+            // For mono: duplicate each sample to both channels
+            for (size_t i = 0; i < frames; i++) {
+                int16_t sample = apply_volume(samples[i], volume);
+                size_t out_idx = i * 2;
+                out[out_idx] = sample;     // Left channel
+                out[out_idx + 1] = sample; // Right channel
+            }
+        } else {
+            // For stereo: process directly
+            for (size_t i = 0; i < frames * 2; i++) {
+                out[i] = apply_volume(samples[i], volume);
+            }
+        }
+    } else {
+        for (size_t i = 0; i < frames; i++) {
+            const uint8_t *frame = &in[i * header->block_align];
+            int16_t left = apply_volume(convert_24_to_16(frame), volume);
+            int16_t right = left;
+            if (header->num_channels == 2) {
+                right = apply_volume(convert_24_to_16(frame + 3), volume);
+            }
+            out[i * 2] = left;
+            out[i * 2 + 1] = right;
+        }
+    }
+
+    return frames * WAV_PLAYER_OUT_FRAME_BYTES;
+}
+
+static size_t file_source_read(void* ctx, void* dst, size_t size) {
+    wav_file_source_t *src = ctx;
+
+    size_t remaining = src->data_size - src->pos;
+    if (size > remaining) {
+        size = remaining;
+    }
+    size_t bytes_read = fread(dst, 1, size, src->fp);
+    src->pos += bytes_read;
+    if (bytes_read < size) {
+        ESP_LOGE(TAG, "File ended %lu bytes into %lu bytes of data", src->pos, src->data_size);
+        src->error = ESP_FAIL;
+    }
+    return bytes_read;
+}
+
+static esp_err_t file_source_seek(void* ctx, uint32_t offset) {
+    wav_file_source_t *src = ctx;
+
+    if (offset > src->data_size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (fseek(src->fp, (long)src->data_offset + offset, SEEK_SET) != 0) {
+        return ESP_FAIL;
+    }
+    src->pos = offset;
+    src->error = ESP_OK;
+    return ESP_OK;
+}
+
+static esp_err_t file_source_error(void* ctx) {
+    wav_file_source_t *src = ctx;
+    return src->error;
+}
+
+static const wav_source_ops_t file_source_ops = {
+    .read = file_source_read,
+    .seek = file_source_seek,
+    .error = file_source_error,
+};
+
+void wav_file_source_init(wav_source_t* source, wav_file_source_t* file, FILE* fp,
+                          const wav_player_info_t* info) {
+    file->fp = fp;
+    file->data_offset = info->data_offset;
+    file->data_size = info->header.data_size;
+    file->pos = 0;
+    file->error = ESP_OK;
+
+    source->ops = &file_source_ops;
+    source->ctx = file;
+    source->block_size = 0;
+}
+
+void wav_fade_block(int16_t* samples, size_t frames, bool fade_in) {
+    for (size_t i = 0; i < frames; i++) {
+        int32_t gain = fade_in ? (int32_t)i : (int32_t)(frames - i);
+        samples[2 * i] = (int32_t)samples[2 * i] * gain / (int32_t)frames;
+        samples[2 * i + 1] = (int32_t)samples[2 * i + 1] * gain / (int32_t)frames;
+    }
+}
+
+size_t wav_conceal_block(int16_t* out, const int16_t* last, size_t last_frames,
+                         size_t block_frames, bool concealed, wav_player_underrun_policy_t policy) {
+    if (concealed || last_frames == 0) {
+        memset(out, 0, block_frames * WAV_PLAYER_OUT_FRAME_BYTES);
+        return block_frames;
+    }
+
+    if (policy == WAV_PLAYER_UNDERRUN_REPEAT) {
+        memmove(out, last, last_frames * WAV_PLAYER_OUT_FRAME_BYTES);
+        wav_fade_block(out, last_frames, false);
+        return last_frames;
+    }
+
+    int16_t left = last[2 * (last_frames - 1)];
+    int16_t right = last[2 * (last_frames - 1) + 1];
+    for (size_t i = 0; i < block_frames; i++) {
+        out[2 * i] = left;
+        out[2 * i + 1] = right;
+    }
+    wav_fade_block(out, block_frames, false);
+    return block_frames;
+}
+
+size_t wav_block_frames(const wav_source_t* source, const wav_header_t* header) {
+    // Always read whole frames so samples never straddle two blocks
+    return source->block_size ?
+           source->block_size / header->block_align :
+           BUFFER_SIZE / WAV_PLAYER_OUT_FRAME_BYTES;
+}
+
+esp_err_t wav_block_reader_init(wav_block_reader_t* reader, wav_source_t* source, bool is_scheduled,
+                                const wav_header_t* header, size_t block_frames, size_t out_blocks) {
+    memset(reader, 0, sizeof(*reader));
+    reader->raw = malloc(block_frames * header->block_align);
+    reader->out_mem = malloc(out_blocks * block_frames * WAV_PLAYER_OUT_FRAME_BYTES);
+    if (reader->raw == NULL || reader->out_mem == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate buffers");
+        wav_block_reader_free(reader);
+        return ESP_ERR_NO_MEM;
+    }
+    if (wav_fx_chain_create(&reader->fx) != ESP_OK) {
+        wav_block_reader_free(reader);
+        return ESP_ERR_NO_MEM;
+    }
+    reader->source = source;
+    reader->is_scheduled = is_scheduled;
+    reader->header = header;
+    reader->block_frames = block_frames;
+    reader->out = reader->out_mem;
+    reader->out_blocks = out_blocks;
+    return ESP_OK;
+}
+
+void wav_block_reader_free(wav_block_reader_t* reader) {
+    wav_fx_chain_free(&reader->fx);
+    free(reader->raw);
+    free(reader->out_mem);
+    reader->raw = NULL;
+    reader->out = NULL;
+    reader->out_mem = NULL;
+}
+
+void wav_block_reader_advance(wav_block_reader_t* reader) {
+    reader->out_slot = (reader->out_slot + 1) % reader->out_blocks;
+    reader->out = reader->out_mem + reader->out_slot * reader->block_frames * 2;
+}
+
+size_t wav_block_reader_next(wav_block_reader_t* reader, uint32_t* read_us, uint32_t* convert_us,
+                             bool* concealed) {
+    WAV_TRACE(WAV_TRACE_READ_BEGIN, 0);
+    int64_t read_start = esp_timer_get_time();
+    size_t bytes_read = reader->source->ops->read(reader->source->ctx, reader->raw,
+                                                  reader->block_frames * reader->header->block_align);
+    WAV_TRACE(WAV_TRACE_READ_END, bytes_read);
+
+    if (bytes_read == 0) {
+        // Keep the sink fed when scheduled data is late instead of stopping
+        wav_player_underrun_policy_t policy;
+        if (!reader->is_scheduled || !wav_sched_take_underrun(reader->source, &policy)) {
+            return 0;
+        }
+        size_t frames = wav_conceal_block(reader->out, reader->last, reader->last_frames,
+                                          reader->block_frames, reader->concealed, policy);
+        reader->concealed = true;
+        *concealed = true;
+        WAV_TRACE(WAV_TRACE_UNDERRUN, policy);
+        return frames;
+    }
+
+    WAV_TRACE(WAV_TRACE_CONVERT_BEGIN, 0);
+    int64_t convert_start = esp_timer_get_time();
+    size_t processed_bytes = wav_convert_block(reader->header, reader->raw, bytes_read,
+                                               reader->out, current_volume);
+    size_t frames = processed_bytes / WAV_PLAYER_OUT_FRAME_BYTES;
+    wav_fx_process(&reader->fx, reader->out, frames);
+    if (reader->concealed && frames > 0) {
+        wav_fade_block(reader->out, frames, true);
+    }
+    WAV_TRACE(WAV_TRACE_CONVERT_END, processed_bytes);
+
+    reader->last = reader->out;
+    reader->last_frames = frames;
+    reader->concealed = false;
+    *concealed = false;
+    *read_us = convert_start - read_start;
+    *convert_us = esp_timer_get_time() - convert_start;
+    return frames;
+}
+
+/**
+ * @brief Timing of a block waiting in a batch for the sink
+ */
+typedef struct {
+    size_t frames;
+    uint32_t read_us;
+    uint32_t convert_us;
+    bool concealed;
+} pending_block_t;
+
+/**
+ * @brief Pass a region to a partial-write sink until all of it is accepted
+ */
+static esp_err_t sink_write_partial(const wav_sink_t* sink, const uint8_t* src, size_t size) {
+    while (size > 0) {
+        size_t written = 0;
+        esp_err_t ret = sink->write_partial_cb(src, size, &written, sink->user_data);
+        if (ret != ESP_OK && ret != ESP_ERR_TIMEOUT) {
+            return ret;
+        }
+        if (written > size) {
+            written = size;
+        }
+        src += written;
+        size -= written;
+
+        if (size > 0 && (ret == ESP_ERR_TIMEOUT || written == 0)) {
+            // Let the sink drain about half of what is still queued for it
+            uint64_t wait_us = (uint64_t)size / WAV_PLAYER_OUT_FRAME_BYTES * 500000 / sink->sample_rate;
+            usleep(wait_us > 1000 ? wait_us : 1000);
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t wav_sink_write(const wav_sink_t* sink, const wav_player_iovec_t* iov, size_t iovcnt) {
+    if (sink->writev_cb != NULL) {
+        return sink->writev_cb(iov, iovcnt, sink->user_data);
+    }
+    for (size_t i = 0; i < iovcnt; i++) {
+        esp_err_t ret = sink->write_partial_cb != NULL ?
+                        sink_write_partial(sink, iov[i].data, iov[i].size) :
+                        sink->write_cb(iov[i].data, iov[i].size, sink->user_data);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Read, convert and write blocks one after another on the calling task
+ */
+static esp_err_t play_blocks(wav_source_t* source, bool is_scheduled, const wav_header_t* header,
+                             size_t block_frames, const wav_sink_t* sink) {
+    // A batch fills the reader's output slots in order, so adjacent blocks merge into one region
+    size_t batch = sink->writev_cb != NULL ? sink->max_blocks : 1;
+    wav_block_reader_t reader;
+    if (wav_block_reader_init(&reader, source, is_scheduled, header, block_frames, batch) != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    esp_err_t ret = ESP_OK;
+    wav_player_iovec_t iov[WAV_PLAYER_WRITEV_MAX_BLOCKS];
+    pending_block_t pending[WAV_PLAYER_WRITEV_MAX_BLOCKS];
+    size_t iovcnt = 0;
+    size_t count = 0;
+
+    for (;;) {
+        pending_block_t *block = &pending[count];
+        block->frames = wav_block_reader_next(&reader, &block->read_us, &block->convert_us,
+                                              &block->concealed);
+        bool end = block->frames == 0;
+        if (!end) {
+            iovcnt = wav_iov_append(iov, iovcnt, reader.out, block->frames * WAV_PLAYER_OUT_FRAME_BYTES);
+            count++;
+            wav_block_reader_advance(&reader);
+        }
+
+        if (count > 0 && (end || count == batch)) {
+            WAV_TRACE(WAV_TRACE_WRITE_BEGIN, count);
+            int64_t write_start = esp_timer_get_time();
+            ret = wav_sink_write(sink, iov, iovcnt);
+            int64_t write_end = esp_timer_get_time();
+            WAV_TRACE(WAV_TRACE_WRITE_END, ret);
+            if (ret != ESP_OK) {
+                ESP_LOGE(TAG, "Write callback failed");
+                break;
+            }
+
+            // Compare against the time the sink needs to play each block
+            for (size_t i = 0; i < count; i++) {
+                wav_playback_delivered(sink->playback, pending[i].frames, pending[i].concealed);
+                if (!pending[i].concealed) {
+                    wav_stats_record_block(pending[i].read_us, pending[i].convert_us,
+                                           (write_end - write_start) / count,
+                                           (uint64_t)pending[i].frames * 1000000 / header->sample_rate);
+                }
+            }
+            iovcnt = 0;
+            count = 0;
+        }
+        if (end) {
+            break;
+        }
+    }
+
+    wav_block_reader_free(&reader);
+    if (ret == ESP_OK) {
+        ret = wav_source_error(source);
+    }
+    return ret;
+}
+
+esp_err_t wav_play_source_sink(wav_source_t* source, const wav_header_t* header, const wav_sink_t* sink) {
+    // Retries of a partial-write sink are paced by the playing time of the rest
+    wav_playback_t playback;
+    wav_playback_begin(&playback, header);
+    wav_playback_set_cues(&playback, sink->cues);
+    wav_sink_t paced = *sink;
+    paced.sample_rate = header->sample_rate;
+    paced.playback = &playback;
+    sink = &paced;
+
+    // Route reads through the shared read scheduler when it is running
+    wav_source_t scheduled;
+    bool is_scheduled = wav_sched_attach(source, header, &scheduled) == ESP_OK;
+    if (is_scheduled) {
+        source = &scheduled;
+    }
+
+    size_t block_frames = wav_block_frames(source, header);
+
+    WAV_TRACE(WAV_TRACE_PLAY_BEGIN, header->sample_rate);
+    esp_err_t ret = wav_pipeline_play(source, is_scheduled, header, block_frames, sink);
+    if (ret == ESP_ERR_NOT_SUPPORTED) {
+        ret = play_blocks(source, is_scheduled, header, block_frames, sink);
+    }
+    WAV_TRACE(WAV_TRACE_PLAY_END, ret);
+    wav_playback_end(&playback, ret);
+
+    if (is_scheduled) {
+        scheduled.ops->close(scheduled.ctx);
+    }
+    return ret;
+}
+
+esp_err_t wav_player_play_source(wav_source_t* source, const wav_header_t* header,
+                                 wav_player_write_cb_t write_cb, void* user_data) {
+    wav_sink_t sink = {
+        .write_cb = write_cb,
+        .max_blocks = 1,
+        .user_data = user_data,
+    };
+    return wav_play_source_sink(source, header, &sink);
+}
+
+esp_err_t wav_player_read_file_info(const char* filepath, wav_player_info_t* info, bool all_chunks) {
     FILE* fp = fopen(filepath, "rb");
     if (fp == NULL) {
         ESP_LOGE(TAG, "Failed to open file %s", filepath);
         return ESP_FAIL;
     }
 
-    esp_err_t ret = read_wav_header(fp, header);
+    esp_err_t ret = read_wav_info(fp, info, all_chunks, NULL);
     fclose(fp);
     return ret;
 }
 
-esp_err_t wav_player_play_file(const char* filepath, wav_player_write_cb_t write_cb, void* user_data) {
-    if (write_cb == NULL) {
+esp_err_t wav_player_get_info(const char* filepath, wav_header_t* header) {
+    wav_player_info_t info;
+
+    esp_err_t ret = wav_player_read_file_info(filepath, &info, false);
+    if (ret == ESP_OK) {
+        *header = info.header;
+    }
+    return ret;
+}
+
+esp_err_t wav_player_get_info_ex(const char* filepath, wav_player_info_t* info) {
+    if (filepath == NULL || info == NULL) {
         return ESP_ERR_INVALID_ARG;
     }
+    return wav_player_read_file_info(filepath, info, true);
+}
 
-    FILE* fp = fopen(filepath, "rb");
-    if (fp == NULL) {
+static void log_file_info(const wav_player_info_t* info) {
+    ESP_LOGI(TAG, "WAV file info: channels=%d, sample_rate=%lu, bits_per_sample=%d, block_align=%d, data_size=%lu",
+             info->header.num_channels,
+             info->header.sample_rate,
+             info->header.bits_per_sample,
+             info->header.block_align,
+             info->header.data_size);
+}
+
+static esp_err_t play_open_file(FILE* fp, const wav_player_info_t* info,
+                                wav_player_write_cb_t write_cb, void* user_data) {
+    log_file_info(info);
+
+    wav_file_source_t file;
+    wav_source_t source;
+    wav_file_source_init(&source, &file, fp, info);
+    return wav_player_play_source(&source, &info->header, write_cb, user_data);
+}
+
+esp_err_t wav_file_meta_copy(wav_file_meta_t* dst, const wav_file_meta_t* src) {
+    *dst = *src;
+    dst->cues.cues = NULL;
+    if (src->cues.count > 0) {
+        dst->cues.cues = malloc(src->cues.count * sizeof(wav_player_cue_t));
+        if (dst->cues.cues == NULL) {
+            dst->cues.count = 0;
+            return ESP_ERR_NO_MEM;
+        }
+        memcpy(dst->cues.cues, src->cues.cues, src->cues.count * sizeof(wav_player_cue_t));
+    }
+    return ESP_OK;
+}
+
+void wav_file_meta_free(wav_file_meta_t* meta) {
+    wav_cue_table_free(&meta->cues);
+    memset(meta, 0, sizeof(*meta));
+}
+
+esp_err_t wav_open_file(const char* filepath, bool with_meta, wav_open_file_t* file) {
+    memset(file, 0, sizeof(*file));
+    file->meta = &file->own_meta;
+
+    if (wav_prefetch_open(filepath, &file->source, &file->info, &file->meta) == ESP_OK) {
+        file->prefetched = true;
+        return ESP_OK;
+    }
+
+    esp_err_t ret = wav_pool_acquire(filepath, &file->pooled);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    if (file->pooled != NULL) {
+        file->info = file->pooled->info;
+        file->meta = &file->pooled->meta;
+        wav_file_source_init(&file->source, &file->file, file->pooled->fp, &file->info);
+        return ESP_OK;
+    }
+
+    file->fp = fopen(filepath, "rb");
+    if (file->fp == NULL) {
         ESP_LOGE(TAG, "Failed to open file %s", filepath);
         return ESP_FAIL;
     }
 
-    wav_header_t wav_header;
-    if (read_wav_header(fp, &wav_header) != ESP_OK || !is_valid_wav_header(&wav_header)) {
+    ret = read_wav_info(file->fp, &file->info, false, with_meta ? &file->own_meta : NULL);
+    if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Invalid WAV header");
-        fclose(fp);
-        return ESP_FAIL;
+        wav_file_meta_free(&file->own_meta);
+        fclose(file->fp);
+        file->fp = NULL;
+        return ret;
     }
-    ESP_LOGI(TAG, "WAV file info: channels=%d, sample_rate=%lu, bits_per_sample=%d, block_align=%d, data_size=%lu",
-             wav_header.num_channels,
-             wav_header.sample_rate,
-             wav_header.bits_per_sample,
-             wav_header.block_align,
-             wav_header.data_size);
-
-    uint8_t *buffer = malloc(BUFFER_SIZE);
-    uint8_t *processed_buffer = malloc(BUFFER_SIZE);
-    if (buffer == NULL || processed_buffer == NULL) {
-        ESP_LOGE(TAG, "Failed to allocate buffers");
-        free(buffer);
-        free(processed_buffer);
-        fclose(fp);
+    wav_file_source_init(&file->source, &file->file, file->fp, &file->info);
+    return ESP_OK;
+}
+
+void wav_close_file(wav_open_file_t* file) {
+    if (file->prefetched) {
+        file->source.ops->close(file->source.ctx);
+    } else if (file->pooled != NULL) {
+        wav_pool_release(file->pooled, true);
+    } else if (file->fp != NULL) {
+        fclose(file->fp);
+    }
+    wav_file_meta_free(&file->own_meta);
+    memset(file, 0, sizeof(*file));
+}
+
+static esp_err_t play_file_sink(const char* filepath, const wav_sink_t* sink) {
+    wav_open_file_t file;
+    // Cues are only worth walking the chunks past the data when someone receives events
+    bool events = wav_events_enabled();
+    if (wav_open_file(filepath, events, &file) != ESP_OK) {
         return ESP_FAIL;
     }
 
-    size_t bytes_read;
-    esp_err_t ret = ESP_OK;
-    
-    // For mono files, read half the buffer size to account for stereo conversion
-    size_t read_size = (wav_header.num_channels == 1) ? 
-                       (BUFFER_SIZE / 2) : BUFFER_SIZE;
-    
-    while ((bytes_read = fread(buffer, 1, read_size, fp)) > 0) {
-        size_t processed_bytes = 0;
-
-        if (wav_header.bits_per_sample == 16) {
-            int16_t *samples = (int16_t*)buffer;
-            int16_t *processed = (int16_t*)processed_buffer;
-            size_t samples_per_channel = bytes_read / wav_header.block_align;
-            
-            if (wav_header.num_channels == 1) {
-                // For mono: duplicate each sample to both channels
-                for (size_t i = 0; i < samples_per_channel; i++) {
-                    int16_t sample = apply_volume(samples[i], current_volume);
-                    size_t out_idx = i * 2;
-                    processed[out_idx] = sample;     // Left channel
-                    processed[out_idx + 1] = sample; // Right channel
-                }
-                processed_bytes = samples_per_channel * 4; // 2 channels * 2 bytes per sample
-            } else {
-                // For stereo: process directly
-                for (size_t i = 0; i < samples_per_channel * 2; i++) {
-                    processed[i] = apply_volume(samples[i], current_volume);
-                }
-                processed_bytes = bytes_read;
-            }
-        } else if (wav_header.bits_per_sample == 24) {
-            int16_t *processed = (int16_t*)processed_buffer;
-            size_t sample_count = bytes_read / 3;  // Count of 24-bit samples
-            size_t out_idx = 0;
-            
-            // Process each 24-bit sample
-            for (size_t i = 0; i < sample_count; i++) {
-                size_t in_idx = i * 3;  // Each sample is 3 bytes
-                int16_t sample = convert_24_to_16(&buffer[in_idx]);
-                processed[out_idx++] = apply_volume(sample, current_volume);
-            }
-            processed_bytes = out_idx * sizeof(int16_t);
-        }
+    wav_sink_t cued = *sink;
+    if (events) {
+        cued.cues = &file.meta->cues;
+    }
 
-        ret = write_cb(processed_buffer, processed_bytes, user_data);
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "Write callback failed");
-            break;
-        }
+    log_file_info(&file.info);
+    esp_err_t ret = wav_play_source_sink(&file.source, &file.info.header, &cued);
+    wav_close_file(&file);
+    return ret;
+}
+
+esp_err_t wav_player_play_file(const char* filepath, wav_player_write_cb_t write_cb, void* user_data) {
+    if (write_cb == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    wav_sink_t sink = {
+        .write_cb = write_cb,
+        .max_blocks = 1,
+        .user_data = user_data,
+    };
+    return play_file_sink(filepath, &sink);
+}
+
+esp_err_t wav_player_play_file_vectored(const char* filepath, wav_player_writev_cb_t writev_cb,
+                                        size_t max_blocks, void* user_data) {
+    if (writev_cb == NULL || max_blocks == 0 || max_blocks > WAV_PLAYER_WRITEV_MAX_BLOCKS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    wav_sink_t sink = {
+        .writev_cb = writev_cb,
+        .max_blocks = max_blocks,
+        .user_data = user_data,
+    };
+    return play_file_sink(filepath, &sink);
+}
+
+esp_err_t wav_player_play_file_partial(const char* filepath, wav_player_write_partial_cb_t write_cb,
+                                       void* user_data) {
+    if (write_cb == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    wav_sink_t sink = {
+        .write_partial_cb = write_cb,
+        .max_blocks = 1,
+        .user_data = user_data,
+    };
+    return play_file_sink(filepath, &sink);
+}
+
+esp_err_t wav_player_play_info(const char* filepath, const wav_player_info_t* info,
+                               wav_player_write_cb_t write_cb, void* user_data) {
+    if (filepath == NULL || info == NULL || write_cb == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!is_valid_wav_header(&info->header)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    FILE* fp = fopen(filepath, "rb");
+    if (fp == NULL) {
+        ESP_LOGE(TAG, "Failed to open file %s", filepath);
+        return ESP_FAIL;
+    }
+    if (fseek(fp, info->data_offset, SEEK_SET) != 0) {
+        ESP_LOGE(TAG, "Failed to seek to data in %s", filepath);
+        fclose(fp);
+        return ESP_FAIL;
     }
 
-    free(processed_buffer);
-    free(buffer);
+    esp_err_t ret = play_open_file(fp, info, write_cb, user_data);
     fclose(fp);
     return ret;
 }
@@ -0,0 +1,199 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdatomic.h>
+#include <dirent.h>
+#include <pthread.h>
+#include "wav_player_batch.h"
+#include "wav_player_priv.h"
+#include "esp_log.h"
+
+static const char *TAG = "wav_player_batch";
+
+#define BATCH_MAX_WORKERS 8
+#define BATCH_WORKER_STACK_SIZE 4096
+
+typedef struct {
+    const char* const* paths;
+    wav_player_batch_info_t* results;
+    size_t count;
+    atomic_size_t next;         // next path to parse, shared by all workers
+} batch_job_t;
+
+typedef struct {
+    char** paths;
+    size_t count;
+    size_t capacity;
+} path_list_t;
+
+static void* batch_worker(void* arg) {
+    batch_job_t *job = arg;
+
+    for (;;) {
+        size_t i = atomic_fetch_add(&job->next, 1);
+        if (i >= job->count) {
+            break;
+        }
+        wav_player_batch_info_t *result = &job->results[i];
+        // Zeroed so a file that fails before its header is read reports no stale format
+        wav_player_info_t info = {0};
+        result->err = wav_player_read_file_info(job->paths[i], &info, false);
+        result->header = info.header;
+        result->data_offset = info.data_offset;
+        result->duration_ms = info.duration_ms;
+    }
+    return NULL;
+}
+
+static esp_err_t walk_dir(char* path, size_t len, wav_player_walk_cb_t cb, void* ctx) {
+    DIR *dir = opendir(path);
+    if (dir == NULL) {
+        ESP_LOGE(TAG, "Failed to open directory %s", path);
+        return ESP_FAIL;
+    }
+
+    esp_err_t ret = ESP_OK;
+    struct dirent *ent;
+    while (ret == ESP_OK && (ent = readdir(dir)) != NULL) {
+        if (ent->d_name[0] == '.') {
+            continue;
+        }
+
+        size_t name_len = strlen(ent->d_name);
+        if (len + 1 + name_len >= WAV_PLAYER_MAX_PATH) {
+            ESP_LOGW(TAG, "Path too long: %s/%s", path, ent->d_name);
+            continue;
+        }
+        path[len] = '/';
+        memcpy(&path[len + 1], ent->d_name, name_len + 1);
+
+        if (ent->d_type == DT_DIR) {
+            ret = walk_dir(path, len + 1 + name_len, cb, ctx);
+        } else if (name_len > 4 && strcasecmp(&ent->d_name[name_len - 4], ".wav") == 0) {
+            ret = cb(path, ctx);
+        }
+        path[len] = '\0';
+    }
+
+    closedir(dir);
+    return ret;
+}
+
+esp_err_t wav_player_walk_dir(const char* dir, wav_player_walk_cb_t cb, void* ctx) {
+    char path[WAV_PLAYER_MAX_PATH];
+    size_t len = strlen(dir);
+    while (len > 1 && dir[len - 1] == '/') {
+        len--;
+    }
+    if (len >= sizeof(path)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memcpy(path, dir, len);
+    path[len] = '\0';
+
+    return walk_dir(path, len, cb, ctx);
+}
+
+static esp_err_t path_list_add(const char* path, void* ctx) {
+    path_list_t *list = ctx;
+
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 16;
+        char **paths = realloc(list->paths, capacity * sizeof(char*));
+        if (paths == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+        list->paths = paths;
+        list->capacity = capacity;
+    }
+
+    list->paths[list->count] = strdup(path);
+    if (list->paths[list->count] == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    list->count++;
+    return ESP_OK;
+}
+
+esp_err_t wav_player_get_info_batch(const char* const* paths, size_t count,
+                                    wav_player_batch_info_t* results, size_t num_workers) {
+    if ((paths == NULL || results == NULL) && count > 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (num_workers == 0) {
+        num_workers = wav_player_num_cores();
+    }
+    if (num_workers > BATCH_MAX_WORKERS) {
+        num_workers = BATCH_MAX_WORKERS;
+    }
+    if (num_workers > count) {
+        num_workers = count;
+    }
+
+    batch_job_t job = {
+        .paths = paths,
+        .results = results,
+        .count = count,
+    };
+    atomic_init(&job.next, 0);
+
+    // Worker i is pinned to core i, the caller takes its share on its own core
+    pthread_t threads[BATCH_MAX_WORKERS];
+    size_t started = 0;
+    size_t cores = wav_player_num_cores();
+    for (size_t i = 1; i < num_workers; i++) {
+        if (wav_player_thread_create(&threads[started], batch_worker, &job, "wav_batch",
+                                     (int)(i % cores), BATCH_WORKER_STACK_SIZE) != ESP_OK) {
+            break;
+        }
+        started++;
+    }
+
+    batch_worker(&job);
+
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t wav_player_get_info_dir(const char* dir, wav_player_batch_dir_t* out, size_t num_workers) {
+    if (dir == NULL || out == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(out, 0, sizeof(*out));
+
+    path_list_t list = {0};
+    esp_err_t ret = wav_player_walk_dir(dir, path_list_add, &list);
+    out->paths = list.paths;
+    out->count = list.count;
+    if (ret != ESP_OK) {
+        wav_player_batch_dir_free(out);
+        return ret;
+    }
+
+    out->results = calloc(list.count ? list.count : 1, sizeof(wav_player_batch_info_t));
+    if (out->results == NULL) {
+        wav_player_batch_dir_free(out);
+        return ESP_ERR_NO_MEM;
+    }
+
+    return wav_player_get_info_batch((const char* const*)out->paths, out->count,
+                                     out->results, num_workers);
+}
+
+void wav_player_batch_dir_free(wav_player_batch_dir_t* dir_info) {
+    if (dir_info == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; i < dir_info->count; i++) {
+        free(dir_info->paths[i]);
+    }
+    free(dir_info->paths);
+    free(dir_info->results);
+    memset(dir_info, 0, sizeof(*dir_info));
+}
@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "wav_player_cue.h"
+#include "wav_player_priv.h"
+#include "esp_log.h"
+
+static const char *TAG = "wav_player_cue";
+
+/** Size of one cue point record in the cue chunk */
+#define CUE_POINT_SIZE 24
+
+/**
+ * @brief Load the cue points of a cue chunk body
+ */
+static esp_err_t read_cue_chunk(FILE* fp, uint32_t offset, uint32_t size, wav_cue_table_t* table) {
+    uint8_t count_bytes[4];
+    if (size < sizeof(count_bytes) || fseek(fp, offset, SEEK_SET) != 0 ||
+        fread(count_bytes, 1, sizeof(count_bytes), fp) != sizeof(count_bytes)) {
+        return ESP_OK;
+    }
+
+    // The declared count is not trusted beyond what the chunk can hold
+    size_t count = read_le32(count_bytes);
+    if (count > (size - sizeof(count_bytes)) / CUE_POINT_SIZE) {
+        count = (size - sizeof(count_bytes)) / CUE_POINT_SIZE;
+    }
+    if (count == 0) {
+        return ESP_OK;
+    }
+
+    table->cues = calloc(count, sizeof(wav_player_cue_t));
+    if (table->cues == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate %u cue points", (unsigned)count);
+        return ESP_ERR_NO_MEM;
+    }
+    for (size_t i = 0; i < count; i++) {
+        uint8_t record[CUE_POINT_SIZE];
+        if (fread(record, 1, sizeof(record), fp) != sizeof(record)) {
+            break;
+        }
+        table->cues[i].id = read_le32(&record[0]);
+        table->cues[i].frame = read_le32(&record[20]);
+        table->count++;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Attach the labl entries of a LIST/adtl chunk body to their cues
+ */
+static void read_adtl_labels(FILE* fp, uint32_t offset, uint32_t size, wav_cue_table_t* table) {
+    // Skip the "adtl" list type
+    uint32_t pos = 4;
+
+    while (pos + 8 <= size) {
+        uint8_t sub[12];
+        if (fseek(fp, offset + pos, SEEK_SET) != 0 || fread(sub, 1, 8, fp) != 8) {
+            return;
+        }
+        uint32_t sub_size = read_le32(&sub[4]);
+        // A sub-chunk running past the list ends it, before pos can wrap
+        if (sub_size > size - pos - 8) {
+            return;
+        }
+        if (memcmp(sub, "labl", 4) == 0 && sub_size >= 4 && fread(&sub[8], 1, 4, fp) == 4) {
+            uint32_t id = read_le32(&sub[8]);
+            for (size_t i = 0; i < table->count; i++) {
+                if (table->cues[i].id != id) {
+                    continue;
+                }
+                size_t len = sub_size - 4;
+                if (len > WAV_PLAYER_CUE_LABEL_MAX - 1) {
+                    len = WAV_PLAYER_CUE_LABEL_MAX - 1;
+                }
+                len = fread(table->cues[i].label, 1, len, fp);
+                table->cues[i].label[len] = '\0';
+                break;
+            }
+        }
+        pos += 8 + sub_size + (sub_size & 1);
+    }
+}
+
+static int compare_cues(const void* a, const void* b) {
+    const wav_player_cue_t *x = a;
+    const wav_player_cue_t *y = b;
+    if (x->frame != y->frame) {
+        return x->frame < y->frame ? -1 : 1;
+    }
+    return x->id < y->id ? -1 : x->id > y->id;
+}
+
+esp_err_t wav_cue_table_read(FILE* fp, uint32_t cue_offset, uint32_t cue_size,
+                             uint32_t adtl_offset, uint32_t adtl_size, wav_cue_table_t* table) {
+    memset(table, 0, sizeof(*table));
+
+    esp_err_t ret = read_cue_chunk(fp, cue_offset, cue_size, table);
+    if (ret != ESP_OK) {
+        wav_cue_table_free(table);
+        return ret;
+    }
+    if (adtl_offset != 0 && table->count > 0) {
+        read_adtl_labels(fp, adtl_offset, adtl_size, table);
+    }
+    if (table->count > 1) {
+        qsort(table->cues, table->count, sizeof(wav_player_cue_t), compare_cues);
+    }
+    return ESP_OK;
+}
+
+void wav_cue_table_free(wav_cue_table_t* table) {
+    free(table->cues);
+    memset(table, 0, sizeof(*table));
+}
+
+esp_err_t wav_player_get_cues(const char* filepath, wav_player_cue_t* cues, size_t max_cues, size_t* count) {
+    if (filepath == NULL || count == NULL || (cues == NULL && max_cues > 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    wav_open_file_t file;
+    esp_err_t ret = wav_open_file(filepath, true, &file);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    const wav_cue_table_t *table = &file.meta->cues;
+    if (max_cues > table->count) {
+        max_cues = table->count;
+    }
+    if (max_cues > 0) {
+        memcpy(cues, table->cues, max_cues * sizeof(wav_player_cue_t));
+    }
+    *count = table->count;
+    wav_close_file(&file);
+    return ESP_OK;
+}
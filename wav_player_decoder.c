@@ -0,0 +1,327 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "wav_player_decoder.h"
+#include "wav_player_priv.h"
+#include "wav_player_trace_priv.h"
+#include "esp_log.h"
+
+static const char *TAG = "wav_player_decoder";
+
+/** Bytes of the fmt chunk body that are parsed, the rest is skipped */
+#define DECODER_FMT_SIZE 40
+
+/** Bounce buffer for 16-bit input that is not 2-byte aligned */
+#define DECODER_BOUNCE_SIZE 256
+
+typedef enum {
+    DECODER_RIFF,               // collecting the 12-byte RIFF header
+    DECODER_CHUNK,              // collecting an 8-byte chunk header
+    DECODER_FMT,                // collecting the fmt chunk body
+    DECODER_SKIP,               // skipping the rest of a chunk
+    DECODER_DATA,               // converting PCM frames
+    DECODER_DONE,               // data chunk finished, ignoring the rest
+    DECODER_ERROR,
+} decoder_state_t;
+
+struct wav_player_decoder {
+    decoder_state_t state;
+    wav_player_info_t info;
+    bool has_fmt;
+    uint8_t field[DECODER_FMT_SIZE];    // header field being collected
+    size_t field_len;
+    size_t field_need;
+    uint32_t offset;            // stream offset of the next input byte
+    uint32_t skip;              // bytes left to skip in DECODER_SKIP
+    uint32_t data_left;         // PCM bytes left in the data chunk
+    uint8_t partial[6];         // frame cut by the end of the previous fragment
+    size_t partial_len;
+    uint16_t bounce[DECODER_BOUNCE_SIZE / 2];
+    wav_fx_chain_t fx;          // effect chain of this stream, kept across resets
+};
+
+esp_err_t wav_player_decoder_create(wav_player_decoder_t* decoder) {
+    if (decoder == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    wav_player_decoder_t d = malloc(sizeof(*d));
+    if (d == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (wav_fx_chain_create(&d->fx) != ESP_OK) {
+        free(d);
+        return ESP_ERR_NO_MEM;
+    }
+    wav_player_decoder_reset(d);
+    *decoder = d;
+    return ESP_OK;
+}
+
+void wav_player_decoder_reset(wav_player_decoder_t d) {
+    if (d == NULL) {
+        return;
+    }
+    memset(d, 0, offsetof(struct wav_player_decoder, bounce));
+    d->state = DECODER_RIFF;
+    d->field_need = 12;
+    wav_fx_chain_reset(&d->fx);
+}
+
+void wav_player_decoder_delete(wav_player_decoder_t d) {
+    if (d != NULL) {
+        wav_fx_chain_free(&d->fx);
+    }
+    free(d);
+}
+
+static void expect_field(wav_player_decoder_t d, decoder_state_t state, size_t size) {
+    d->state = state;
+    d->field_len = 0;
+    d->field_need = size;
+}
+
+static void skip_bytes(wav_player_decoder_t d, uint32_t size) {
+    if (size == 0) {
+        expect_field(d, DECODER_CHUNK, 8);
+    } else {
+        d->state = DECODER_SKIP;
+        d->skip = size;
+    }
+}
+
+static esp_err_t fail(wav_player_decoder_t d) {
+    d->state = DECODER_ERROR;
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Act on a completed header field
+ */
+static esp_err_t header_field(wav_player_decoder_t d) {
+    const uint8_t *field = d->field;
+
+    switch (d->state) {
+    case DECODER_RIFF:
+        if (memcmp(field, "RIFF", 4) != 0 || memcmp(&field[8], "WAVE", 4) != 0) {
+            ESP_LOGE(TAG, "Not a RIFF/WAVE stream");
+            return fail(d);
+        }
+        expect_field(d, DECODER_CHUNK, 8);
+        return ESP_OK;
+
+    case DECODER_CHUNK: {
+        uint32_t size = read_le32(&field[4]);
+        // Chunk bodies are padded to an even size
+        uint32_t padded = size + (size & 1);
+
+        if (d->info.chunk_count < WAV_PLAYER_MAX_CHUNKS) {
+            wav_chunk_info_t *entry = &d->info.chunks[d->info.chunk_count++];
+            memcpy(entry->id, field, 4);
+            entry->offset = d->offset;
+            entry->size = size;
+        }
+
+        if (memcmp(field, "fmt ", 4) == 0) {
+            size_t body_len = size < DECODER_FMT_SIZE ? size : DECODER_FMT_SIZE;
+            d->skip = padded - body_len;
+            expect_field(d, DECODER_FMT, body_len);
+            if (body_len == 0) {
+                return header_field(d);
+            }
+        } else if (memcmp(field, "data", 4) == 0) {
+            if (!d->has_fmt) {
+                ESP_LOGE(TAG, "Missing fmt chunk");
+                return fail(d);
+            }
+            d->info.data_offset = d->offset;
+            d->info.header.data_size = size;
+            if (validate_wav_info(&d->info) != ESP_OK) {
+                return fail(d);
+            }
+            d->data_left = size;
+            d->state = size > 0 ? DECODER_DATA : DECODER_DONE;
+            ESP_LOGI(TAG, "Stream: channels=%d, sample_rate=%lu, bits_per_sample=%d",
+                     d->info.header.num_channels, d->info.header.sample_rate,
+                     d->info.header.bits_per_sample);
+        } else {
+            skip_bytes(d, padded);
+        }
+        return ESP_OK;
+    }
+
+    case DECODER_FMT:
+        if (parse_fmt_chunk(field, d->field_len, &d->info) != ESP_OK) {
+            return fail(d);
+        }
+        d->has_fmt = true;
+        skip_bytes(d, d->skip);
+        return ESP_OK;
+
+    default:
+        return fail(d);
+    }
+}
+
+/**
+ * @brief Consume header bytes until the data chunk starts
+ *
+ * @return Bytes consumed
+ */
+static size_t decode_header(wav_player_decoder_t d, const uint8_t* in, size_t size) {
+    size_t used = 0;
+
+    while (used < size && d->state < DECODER_DATA) {
+        size_t n;
+        if (d->state == DECODER_SKIP) {
+            n = size - used < d->skip ? size - used : d->skip;
+            d->skip -= n;
+            used += n;
+            d->offset += n;
+            if (d->skip == 0) {
+                expect_field(d, DECODER_CHUNK, 8);
+            }
+            continue;
+        }
+
+        n = d->field_need - d->field_len;
+        if (n > size - used) {
+            n = size - used;
+        }
+        memcpy(&d->field[d->field_len], &in[used], n);
+        d->field_len += n;
+        used += n;
+        d->offset += n;
+        if (d->field_len == d->field_need && header_field(d) != ESP_OK) {
+            break;
+        }
+    }
+    return used;
+}
+
+/**
+ * @brief Convert whole frames, bouncing 16-bit input that is not aligned
+ */
+static void convert_frames(wav_player_decoder_t d, const uint8_t* in, size_t frames, int16_t* out,
+                           int volume) {
+    const wav_header_t *header = &d->info.header;
+
+    if (header->bits_per_sample == 24 || ((uintptr_t)in & 1) == 0) {
+        wav_convert_block(header, in, frames * header->block_align, out, volume);
+        return;
+    }
+
+    size_t chunk_frames = DECODER_BOUNCE_SIZE / header->block_align;
+    while (frames > 0) {
+        size_t n = frames < chunk_frames ? frames : chunk_frames;
+        memcpy(d->bounce, in, n * header->block_align);
+        wav_convert_block(header, (const uint8_t*)d->bounce, n * header->block_align, out, volume);
+        in += n * header->block_align;
+        out += n * 2;
+        frames -= n;
+    }
+}
+
+/**
+ * @brief Convert PCM bytes of the data chunk
+ *
+ * @return Bytes consumed
+ */
+static size_t decode_data(wav_player_decoder_t d, const uint8_t* in, size_t size,
+                          int16_t* out, size_t out_frames, size_t* out_produced) {
+    size_t block_align = d->info.header.block_align;
+    int volume = wav_player_get_volume();
+    size_t used = 0;
+    size_t produced = 0;
+
+    if (size > d->data_left) {
+        size = d->data_left;
+    }
+
+    // Complete a frame cut by the previous fragment
+    if (d->partial_len > 0 && out_frames > 0) {
+        size_t n = block_align - d->partial_len;
+        if (n > size) {
+            n = size;
+        }
+        memcpy(&d->partial[d->partial_len], in, n);
+        d->partial_len += n;
+        used += n;
+        if (d->partial_len == block_align) {
+            convert_frames(d, d->partial, 1, out, volume);
+            d->partial_len = 0;
+            produced = 1;
+        }
+    }
+
+    if (d->partial_len == 0) {
+        size_t frames = (size - used) / block_align;
+        if (frames > out_frames - produced) {
+            frames = out_frames - produced;
+        }
+        convert_frames(d, &in[used], frames, &out[produced * 2], volume);
+        used += frames * block_align;
+        produced += frames;
+
+        // Keep a trailing partial frame unless the output is full
+        size_t rest = size - used;
+        if (rest > 0 && rest < block_align && produced < out_frames) {
+            memcpy(d->partial, &in[used], rest);
+            d->partial_len = rest;
+            used += rest;
+        }
+    }
+
+    d->data_left -= used;
+    d->offset += used;
+    if (d->data_left < block_align - d->partial_len) {
+        // A truncated last frame can never complete
+        d->state = DECODER_DONE;
+    }
+
+    *out_produced = produced;
+    return used;
+}
+
+esp_err_t wav_player_decoder_decode(wav_player_decoder_t d, const void* in, size_t in_size,
+                                    size_t* in_used, int16_t* out, size_t out_frames,
+                                    size_t* out_produced) {
+    if (d == NULL || (in == NULL && in_size > 0) || in_used == NULL ||
+        (out == NULL && out_frames > 0) || out_produced == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    const uint8_t *bytes = in;
+    size_t used = decode_header(d, bytes, in_size);
+    size_t produced = 0;
+
+    if (d->state == DECODER_DATA) {
+        WAV_TRACE(WAV_TRACE_CONVERT_BEGIN, 0);
+        used += decode_data(d, &bytes[used], in_size - used, out, out_frames, &produced);
+        wav_fx_process(&d->fx, out, produced);
+        WAV_TRACE(WAV_TRACE_CONVERT_END, produced * WAV_PLAYER_OUT_FRAME_BYTES);
+    }
+    if (d->state == DECODER_DONE) {
+        d->offset += in_size - used;
+        used = in_size;
+    }
+
+    *in_used = used;
+    *out_produced = produced;
+    return d->state == DECODER_ERROR ? ESP_FAIL : ESP_OK;
+}
+
+esp_err_t wav_player_decoder_get_info(wav_player_decoder_t d, wav_player_info_t* info) {
+    if (d == NULL || info == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (d->state != DECODER_DATA && d->state != DECODER_DONE) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    *info = d->info;
+    return ESP_OK;
+}
+
+bool wav_player_decoder_is_done(wav_player_decoder_t d) {
+    return d != NULL && d->state == DECODER_DONE;
+}
@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "wav_player_events.h"
+#include "wav_player_priv.h"
+
+static pthread_mutex_t events_lock = PTHREAD_MUTEX_INITIALIZER;
+static wav_player_event_cb_t event_cb;
+static void* event_user_data;
+static uint32_t event_progress_frames;
+
+void wav_player_set_event_cb(wav_player_event_cb_t cb, void* user_data, uint32_t progress_frames) {
+    pthread_mutex_lock(&events_lock);
+    event_cb = cb;
+    event_user_data = user_data;
+    event_progress_frames = progress_frames;
+    pthread_mutex_unlock(&events_lock);
+}
+
+bool wav_events_enabled(void) {
+    pthread_mutex_lock(&events_lock);
+    bool enabled = event_cb != NULL;
+    pthread_mutex_unlock(&events_lock);
+    return enabled;
+}
+
+static void dispatch(const wav_playback_t* pb, wav_player_event_type_t type, esp_err_t error,
+                     const wav_player_cue_t* cue) {
+    wav_player_event_t event = {
+        .type = type,
+        .frames = pb->delivered,
+        .sample_rate = pb->sample_rate,
+        .error = error,
+        .cue = cue,
+    };
+    pb->event_cb(&event, pb->event_user_data);
+}
+
+void wav_playback_begin(wav_playback_t* pb, const wav_header_t* header) {
+    memset(pb, 0, sizeof(*pb));
+    pb->sample_rate = header->sample_rate;
+
+    // Taken once so a playback needs no lock per block
+    pthread_mutex_lock(&events_lock);
+    pb->event_cb = event_cb;
+    pb->event_user_data = event_user_data;
+    pb->progress_frames = event_progress_frames;
+    pthread_mutex_unlock(&events_lock);
+    pb->next_progress = pb->progress_frames;
+    pb->next_cue_frame = UINT64_MAX;
+
+    pb->position_id = wav_position_claim();
+    wav_position_clock_write(&pb->clock, 0, pb->sample_rate);
+    wav_position_publish(pb->position_id, 0, pb->sample_rate);
+}
+
+void wav_playback_set_cues(wav_playback_t* pb, const wav_cue_table_t* cues) {
+    pb->cues = cues;
+    pb->next_cue = 0;
+    pb->next_cue_frame = cues != NULL && cues->count > 0 ? cues->cues[0].frame : UINT64_MAX;
+}
+
+void wav_playback_delivered(wav_playback_t* pb, size_t frames, bool concealed) {
+    bool first = pb->delivered == 0;
+    bool underrun = concealed && !pb->concealing;
+    pb->delivered += frames;
+    pb->concealing = concealed;
+    wav_position_clock_write(&pb->clock, pb->delivered, pb->sample_rate);
+    wav_position_publish(pb->position_id, pb->delivered, pb->sample_rate);
+    if (pb->event_cb == NULL || frames == 0) {
+        return;
+    }
+
+    if (first) {
+        dispatch(pb, WAV_PLAYER_EVENT_START, ESP_OK, NULL);
+    }
+    if (underrun) {
+        dispatch(pb, WAV_PLAYER_EVENT_UNDERRUN, ESP_OK, NULL);
+    }
+    // The table is sorted, so blocks without a cue cost one comparison
+    while (pb->delivered > pb->next_cue_frame) {
+        const wav_player_cue_t *cue = &pb->cues->cues[pb->next_cue++];
+        pb->next_cue_frame = pb->next_cue < pb->cues->count ? pb->cues->cues[pb->next_cue].frame
+                                                            : UINT64_MAX;
+        dispatch(pb, WAV_PLAYER_EVENT_CUE, ESP_OK, cue);
+    }
+    if (pb->progress_frames > 0 && pb->delivered >= pb->next_progress) {
+        // One event per block even if it crosses several intervals
+        pb->next_progress += ((pb->delivered - pb->next_progress) / pb->progress_frames + 1) *
+                             pb->progress_frames;
+        dispatch(pb, WAV_PLAYER_EVENT_PROGRESS, ESP_OK, NULL);
+    }
+}
+
+void wav_playback_end(wav_playback_t* pb, esp_err_t ret) {
+    if (pb->event_cb != NULL) {
+        dispatch(pb, ret == ESP_OK ? WAV_PLAYER_EVENT_END : WAV_PLAYER_EVENT_ERROR, ret, NULL);
+    }
+}
@@ -0,0 +1,288 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "wav_player_fx.h"
+#include "wav_player_priv.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "wav_player_fx";
+
+#define FX_WORKER_STACK_SIZE 4096
+
+// fx_lock guards the chain template and the worker, fx_run_lock serializes blocks handed to the worker
+static pthread_mutex_t fx_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t fx_run_lock = PTHREAD_MUTEX_INITIALIZER;
+static wav_player_fx_t fx_chain[WAV_PLAYER_FX_MAX];
+static size_t fx_count;
+
+static pthread_mutex_t fx_work_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t fx_work_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t fx_done_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t fx_worker;
+static atomic_bool fx_worker_running;
+static wav_fx_chain_t* fx_job_chain;
+static int16_t* fx_job_samples;
+static size_t fx_job_frames;
+static uint32_t fx_job_seq;         // blocks posted to the worker
+static uint32_t fx_done_seq;        // blocks the worker finished
+
+static void chain_run_channel(const wav_fx_chain_t* chain, int channel, int16_t* samples, size_t frames) {
+    for (size_t i = 0; i < chain->count; i++) {
+        chain->fx[i].process(chain->fx[i].ctx, channel, samples + channel, frames, 2);
+    }
+}
+
+static void* fx_worker_task(void* arg) {
+    pthread_mutex_lock(&fx_work_lock);
+    for (;;) {
+        while (atomic_load(&fx_worker_running) && fx_job_seq == fx_done_seq) {
+            pthread_cond_wait(&fx_work_cond, &fx_work_lock);
+        }
+        if (!atomic_load(&fx_worker_running)) {
+            break;
+        }
+        wav_fx_chain_t *chain = fx_job_chain;
+        int16_t *samples = fx_job_samples;
+        size_t frames = fx_job_frames;
+        uint32_t seq = fx_job_seq;
+        pthread_mutex_unlock(&fx_work_lock);
+
+        chain_run_channel(chain, 1, samples, frames);
+
+        pthread_mutex_lock(&fx_work_lock);
+        fx_done_seq = seq;
+        pthread_cond_signal(&fx_done_cond);
+    }
+    pthread_mutex_unlock(&fx_work_lock);
+    return NULL;
+}
+
+/**
+ * @brief Run a chain over a stereo block
+ */
+static void chain_run(wav_fx_chain_t* chain, int16_t* samples, size_t frames, bool parallel) {
+    if (!parallel) {
+        chain_run_channel(chain, 0, samples, frames);
+        chain_run_channel(chain, 1, samples, frames);
+        return;
+    }
+
+    // One worker serves every playback, a block keeps it until both channels are done
+    pthread_mutex_lock(&fx_run_lock);
+    pthread_mutex_lock(&fx_work_lock);
+    if (!atomic_load(&fx_worker_running)) {
+        pthread_mutex_unlock(&fx_work_lock);
+        pthread_mutex_unlock(&fx_run_lock);
+        chain_run(chain, samples, frames, false);
+        return;
+    }
+    fx_job_chain = chain;
+    fx_job_samples = samples;
+    fx_job_frames = frames;
+    uint32_t seq = ++fx_job_seq;
+    pthread_cond_signal(&fx_work_cond);
+    pthread_mutex_unlock(&fx_work_lock);
+
+    // Left here, right on the worker: the channels share no state or samples
+    chain_run_channel(chain, 0, samples, frames);
+
+    pthread_mutex_lock(&fx_work_lock);
+    while (fx_done_seq != seq) {
+        pthread_cond_wait(&fx_done_cond, &fx_work_lock);
+    }
+    pthread_mutex_unlock(&fx_work_lock);
+    pthread_mutex_unlock(&fx_run_lock);
+}
+
+static void chain_reset(const wav_fx_chain_t* chain) {
+    for (size_t i = 0; i < chain->count; i++) {
+        if (chain->fx[i].reset != NULL) {
+            chain->fx[i].reset(chain->fx[i].ctx, 0);
+            chain->fx[i].reset(chain->fx[i].ctx, 1);
+        }
+    }
+}
+
+esp_err_t wav_fx_chain_create(wav_fx_chain_t* chain) {
+    pthread_mutex_lock(&fx_lock);
+    chain->count = 0;
+    for (size_t i = 0; i < fx_count; i++) {
+        wav_player_fx_t fx = fx_chain[i];
+        if (fx.create != NULL) {
+            fx.ctx = fx.create(fx_chain[i].ctx);
+            if (fx.ctx == NULL) {
+                pthread_mutex_unlock(&fx_lock);
+                ESP_LOGE(TAG, "Failed to create effect %u state", (unsigned)i);
+                wav_fx_chain_free(chain);
+                return ESP_ERR_NO_MEM;
+            }
+        }
+        chain->fx[chain->count++] = fx;
+    }
+    pthread_mutex_unlock(&fx_lock);
+    return ESP_OK;
+}
+
+void wav_fx_chain_free(wav_fx_chain_t* chain) {
+    for (size_t i = 0; i < chain->count; i++) {
+        if (chain->fx[i].create != NULL && chain->fx[i].destroy != NULL) {
+            chain->fx[i].destroy(chain->fx[i].ctx);
+        }
+    }
+    chain->count = 0;
+}
+
+void wav_fx_chain_reset(wav_fx_chain_t* chain) {
+    chain_reset(chain);
+}
+
+void wav_fx_process(wav_fx_chain_t* chain, int16_t* samples, size_t frames) {
+    if (chain->count == 0 || frames == 0) {
+        return;
+    }
+    chain_run(chain, samples, frames, atomic_load(&fx_worker_running));
+}
+
+esp_err_t wav_player_fx_set_chain(const wav_player_fx_t* chain, size_t count) {
+    if (count > WAV_PLAYER_FX_MAX || (chain == NULL && count > 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (chain[i].process == NULL) {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    pthread_mutex_lock(&fx_lock);
+    if (count > 0) {
+        memcpy(fx_chain, chain, count * sizeof(wav_player_fx_t));
+    }
+    fx_count = count;
+    pthread_mutex_unlock(&fx_lock);
+    return ESP_OK;
+}
+
+esp_err_t wav_player_fx_set_parallel(bool enable, int core_id) {
+    esp_err_t ret = ESP_OK;
+
+    pthread_mutex_lock(&fx_lock);
+    if (enable && !atomic_load(&fx_worker_running)) {
+        // No block may post to the worker until it is known to run
+        pthread_mutex_lock(&fx_run_lock);
+        atomic_store(&fx_worker_running, true);
+        ret = wav_player_thread_create(&fx_worker, fx_worker_task, NULL, "wav_fx",
+                                       core_id, FX_WORKER_STACK_SIZE);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to start effect worker");
+            atomic_store(&fx_worker_running, false);
+            ret = ESP_ERR_NO_MEM;
+        }
+        pthread_mutex_unlock(&fx_run_lock);
+    } else if (!enable && atomic_load(&fx_worker_running)) {
+        // Wait for a block in flight, later blocks see the flag and run serially
+        pthread_mutex_lock(&fx_run_lock);
+        pthread_mutex_lock(&fx_work_lock);
+        atomic_store(&fx_worker_running, false);
+        pthread_cond_signal(&fx_work_cond);
+        pthread_mutex_unlock(&fx_work_lock);
+        pthread_join(fx_worker, NULL);
+        pthread_mutex_unlock(&fx_run_lock);
+    }
+    pthread_mutex_unlock(&fx_lock);
+    return ret;
+}
+
+void wav_player_fx_reset(void) {
+    pthread_mutex_lock(&fx_lock);
+    for (size_t i = 0; i < fx_count; i++) {
+        if (fx_chain[i].create == NULL && fx_chain[i].reset != NULL) {
+            fx_chain[i].reset(fx_chain[i].ctx, 0);
+            fx_chain[i].reset(fx_chain[i].ctx, 1);
+        }
+    }
+    pthread_mutex_unlock(&fx_lock);
+}
+
+static uint32_t hash_block(uint32_t hash, const int16_t* samples, size_t count) {
+    const uint8_t *bytes = (const uint8_t*)samples;
+    for (size_t i = 0; i < count * sizeof(int16_t); i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * @brief Time a fresh copy of the chain over blocks of fixed noise
+ */
+static esp_err_t benchmark_run(int16_t* block, size_t block_frames, size_t blocks, bool parallel,
+                               uint64_t* total_us, uint32_t* hash) {
+    // A chain of its own per run, so both start from the same state and no playback is disturbed
+    wav_fx_chain_t chain;
+    if (wav_fx_chain_create(&chain) != ESP_OK) {
+        return ESP_ERR_NO_MEM;
+    }
+    *total_us = 0;
+    *hash = 2166136261u;
+
+    uint32_t seed = 1;
+    for (size_t b = 0; b < blocks; b++) {
+        for (size_t i = 0; i < block_frames * 2; i++) {
+            seed = seed * 1103515245u + 12345u;
+            block[i] = (int16_t)(seed >> 16);
+        }
+        int64_t start = esp_timer_get_time();
+        chain_run(&chain, block, block_frames, parallel);
+        *total_us += esp_timer_get_time() - start;
+        *hash = hash_block(*hash, block, block_frames * 2);
+    }
+    wav_fx_chain_free(&chain);
+    return ESP_OK;
+}
+
+esp_err_t wav_player_fx_benchmark(size_t block_frames, size_t blocks, wav_player_fx_benchmark_t* result) {
+    if (block_frames == 0 || blocks == 0 || result == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!atomic_load(&fx_worker_running)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // Effects without create run on the ctx live playbacks are processing
+    pthread_mutex_lock(&fx_lock);
+    size_t shared = fx_count;
+    for (size_t i = 0; i < fx_count && shared == fx_count; i++) {
+        if (fx_chain[i].create == NULL) {
+            shared = i;
+        }
+    }
+    pthread_mutex_unlock(&fx_lock);
+    if (shared != fx_count) {
+        ESP_LOGE(TAG, "Effect %u has no create, it cannot be measured beside playback", (unsigned)shared);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    int16_t *block = malloc(block_frames * WAV_PLAYER_OUT_FRAME_BYTES);
+    if (block == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    uint32_t serial_hash;
+    uint32_t parallel_hash;
+    esp_err_t ret = benchmark_run(block, block_frames, blocks, false, &result->serial_us, &serial_hash);
+    if (ret == ESP_OK) {
+        ret = benchmark_run(block, block_frames, blocks, true, &result->parallel_us, &parallel_hash);
+    }
+    free(block);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    result->identical = serial_hash == parallel_hash;
+
+    ESP_LOGI(TAG, "Effect chain: serial %llu us, parallel %llu us, %s",
+             (unsigned long long)result->serial_us, (unsigned long long)result->parallel_us,
+             result->identical ? "identical" : "MISMATCH");
+    return ESP_OK;
+}
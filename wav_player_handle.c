@@ -0,0 +1,300 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "wav_player.h"
+#include "wav_player_priv.h"
+#include "wav_player_trace_priv.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "wav_player_handle";
+
+struct wav_player_handle {
+    wav_open_file_t file;
+    wav_source_t looped;
+    bool is_looped;
+    wav_source_t scheduled;
+    bool is_scheduled;
+    wav_block_reader_t reader;
+    size_t pos;                 // next frame of reader.out to hand out
+    size_t len;                 // frames in reader.out
+    size_t sent;                // bytes of the frame at pos already taken by a partial write
+    wav_player_state_t state;
+    esp_err_t result;           // why playback ended, reported to the trace on close
+    uint32_t read_us;           // timing of the staged block, recorded once it is delivered
+    uint32_t convert_us;
+    bool concealed;
+    wav_playback_t playback;
+};
+
+/**
+ * @brief Stage the next block once the current one is used up
+ *
+ * @return false at the end of the file
+ */
+static bool handle_fill(wav_player_handle_t h) {
+    if (h->pos < h->len) {
+        return true;
+    }
+
+    h->pos = 0;
+    h->len = wav_block_reader_next(&h->reader, &h->read_us, &h->convert_us, &h->concealed);
+    if (h->len == 0) {
+        if (h->state == WAV_PLAYER_STATE_PLAYING) {
+            esp_err_t ret = wav_source_error(h->reader.source);
+            h->state = ret == ESP_OK ? WAV_PLAYER_STATE_FINISHED : WAV_PLAYER_STATE_ERROR;
+            h->result = ret;
+            wav_playback_end(&h->playback, ret);
+        }
+        return false;
+    }
+    return true;
+}
+
+static void handle_record(wav_player_handle_t h, uint32_t write_us) {
+    if (!h->concealed) {
+        wav_stats_record_block(h->read_us, h->convert_us, write_us,
+                               (uint64_t)h->len * 1000000 / h->file.info.header.sample_rate);
+    }
+}
+
+esp_err_t wav_player_open(const char* filepath, wav_player_handle_t* handle) {
+    if (filepath == NULL || handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return wav_handle_open(filepath, false, NULL, handle);
+}
+
+static void handle_release(wav_player_handle_t h) {
+    if (h->is_scheduled) {
+        h->scheduled.ops->close(h->scheduled.ctx);
+    }
+    if (h->is_looped) {
+        h->looped.ops->close(h->looped.ctx);
+    }
+    wav_close_file(&h->file);
+    free(h);
+}
+
+esp_err_t wav_handle_open(const char* filepath, bool looping, const wav_player_loop_t* loop,
+                          wav_player_handle_t* handle) {
+    *handle = NULL;
+
+    wav_player_handle_t h = calloc(1, sizeof(*h));
+    if (h == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    // Looping repeats frames, so only a plain playback maps its cues to delivered frames
+    bool cued = !looping && wav_events_enabled();
+    if (wav_open_file(filepath, cued || (looping && loop == NULL), &h->file) != ESP_OK) {
+        free(h);
+        return ESP_FAIL;
+    }
+
+    wav_source_t *source = &h->file.source;
+    const wav_header_t *header = &h->file.info.header;
+    if (looping) {
+        // Without a region the smpl chunk comes from the file just opened
+        const wav_player_loop_t *region = loop != NULL ? loop : &h->file.meta->loop;
+        esp_err_t ret = ESP_ERR_NOT_FOUND;
+        if (loop != NULL || h->file.meta->has_loop) {
+            ret = wav_loop_source_create(source, &h->file.info, region, &h->looped);
+        }
+        if (ret != ESP_OK) {
+            wav_close_file(&h->file);
+            free(h);
+            return ret;
+        }
+        h->is_looped = true;
+        source = &h->looped;
+    }
+    h->is_scheduled = wav_sched_attach(source, header, &h->scheduled) == ESP_OK;
+    if (h->is_scheduled) {
+        source = &h->scheduled;
+    }
+
+    if (wav_block_reader_init(&h->reader, source, h->is_scheduled, header,
+                              wav_block_frames(source, header), 1) != ESP_OK) {
+        handle_release(h);
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "Opened %s: channels=%d, sample_rate=%lu, bits_per_sample=%d", filepath,
+             header->num_channels, header->sample_rate, header->bits_per_sample);
+    WAV_TRACE(WAV_TRACE_PLAY_BEGIN, header->sample_rate);
+    wav_playback_begin(&h->playback, header);
+    if (cued) {
+        wav_playback_set_cues(&h->playback, &h->file.meta->cues);
+    }
+    *handle = h;
+    return ESP_OK;
+}
+
+esp_err_t wav_player_read(wav_player_handle_t h, int16_t* out, size_t frames, size_t* frames_read) {
+    if (h == NULL || (out == NULL && frames > 0) || frames_read == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (h->sent > 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    size_t done = 0;
+    while (done < frames) {
+        if (h->pos == h->len) {
+            if (!handle_fill(h)) {
+                break;
+            }
+            handle_record(h, 0);
+        }
+
+        size_t n = h->len - h->pos;
+        if (n > frames - done) {
+            n = frames - done;
+        }
+        memcpy(&out[done * 2], &h->reader.out[h->pos * 2], n * WAV_PLAYER_OUT_FRAME_BYTES);
+        h->pos += n;
+        done += n;
+        wav_playback_delivered(&h->playback, n, h->concealed);
+    }
+
+    *frames_read = done;
+    return h->state == WAV_PLAYER_STATE_ERROR ? ESP_FAIL : ESP_OK;
+}
+
+esp_err_t wav_player_step(wav_player_handle_t h, wav_player_write_cb_t write_cb, void* user_data,
+                          wav_player_state_t* state) {
+    if (h == NULL || write_cb == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (h->state == WAV_PLAYER_STATE_ERROR) {
+        if (state != NULL) {
+            *state = h->state;
+        }
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t ret = ESP_OK;
+    bool fresh = h->pos == h->len;
+    if (handle_fill(h)) {
+        WAV_TRACE(WAV_TRACE_WRITE_BEGIN, 0);
+        int64_t write_start = esp_timer_get_time();
+        ret = write_cb((const uint8_t*)&h->reader.out[h->pos * 2] + h->sent,
+                       (h->len - h->pos) * WAV_PLAYER_OUT_FRAME_BYTES - h->sent, user_data);
+        uint32_t write_us = esp_timer_get_time() - write_start;
+        WAV_TRACE(WAV_TRACE_WRITE_END, ret);
+
+        if (ret == ESP_OK) {
+            if (fresh) {
+                handle_record(h, write_us);
+            }
+            wav_playback_delivered(&h->playback, h->len - h->pos, h->concealed);
+            h->pos = h->len;
+            h->sent = 0;
+        } else {
+            ESP_LOGE(TAG, "Write callback failed");
+            h->state = WAV_PLAYER_STATE_ERROR;
+            h->result = ret;
+            wav_playback_end(&h->playback, ret);
+        }
+    } else if (h->state == WAV_PLAYER_STATE_ERROR) {
+        ret = ESP_FAIL;
+    }
+
+    if (state != NULL) {
+        *state = h->state;
+    }
+    return ret;
+}
+
+esp_err_t wav_player_step_partial(wav_player_handle_t h, wav_player_write_partial_cb_t write_cb,
+                                  void* user_data, wav_player_state_t* state) {
+    if (h == NULL || write_cb == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (h->state == WAV_PLAYER_STATE_ERROR) {
+        if (state != NULL) {
+            *state = h->state;
+        }
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t ret = ESP_OK;
+    bool fresh = h->pos == h->len;
+    if (handle_fill(h)) {
+        const uint8_t *src = (const uint8_t*)&h->reader.out[h->pos * 2] + h->sent;
+        size_t size = (h->len - h->pos) * WAV_PLAYER_OUT_FRAME_BYTES - h->sent;
+        size_t written = 0;
+
+        WAV_TRACE(WAV_TRACE_WRITE_BEGIN, 0);
+        int64_t write_start = esp_timer_get_time();
+        ret = write_cb(src, size, &written, user_data);
+        uint32_t write_us = esp_timer_get_time() - write_start;
+        WAV_TRACE(WAV_TRACE_WRITE_END, ret);
+
+        if (ret == ESP_OK || ret == ESP_ERR_TIMEOUT) {
+            if (fresh) {
+                handle_record(h, write_us);
+            }
+            // Keep the remainder, whole frames in pos and a partly written frame in sent
+            written = (written < size ? written : size) + h->sent;
+            h->pos += written / WAV_PLAYER_OUT_FRAME_BYTES;
+            h->sent = written % WAV_PLAYER_OUT_FRAME_BYTES;
+            wav_playback_delivered(&h->playback, written / WAV_PLAYER_OUT_FRAME_BYTES, h->concealed);
+        } else {
+            ESP_LOGE(TAG, "Write callback failed");
+            h->state = WAV_PLAYER_STATE_ERROR;
+            h->result = ret;
+            wav_playback_end(&h->playback, ret);
+        }
+    } else if (h->state == WAV_PLAYER_STATE_ERROR) {
+        ret = ESP_FAIL;
+    }
+
+    if (state != NULL) {
+        *state = h->state;
+    }
+    return ret;
+}
+
+wav_player_state_t wav_player_get_state(wav_player_handle_t h) {
+    return h != NULL ? h->state : WAV_PLAYER_STATE_ERROR;
+}
+
+esp_err_t wav_player_handle_get_position(wav_player_handle_t h, wav_player_position_t* pos) {
+    if (h == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return wav_position_clock_get(&h->playback.clock, pos);
+}
+
+esp_err_t wav_player_handle_set_sink_latency(wav_player_handle_t h, uint32_t frames) {
+    if (h == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    atomic_store_explicit(&h->playback.clock.latency, frames, memory_order_relaxed);
+    return ESP_OK;
+}
+
+esp_err_t wav_player_handle_get_info(wav_player_handle_t h, wav_player_info_t* info) {
+    if (h == NULL || info == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *info = h->file.info;
+    return ESP_OK;
+}
+
+void wav_player_close(wav_player_handle_t h) {
+    if (h == NULL) {
+        return;
+    }
+
+    if (h->state == WAV_PLAYER_STATE_PLAYING) {
+        // Closed before the end, report the playback as stopped
+        h->result = ESP_ERR_INVALID_STATE;
+        wav_playback_end(&h->playback, h->result);
+    }
+    WAV_TRACE(WAV_TRACE_PLAY_END, h->result);
+    wav_block_reader_free(&h->reader);
+    handle_release(h);
+}
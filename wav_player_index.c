@@ -0,0 +1,505 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "wav_player_index.h"
+#include "wav_player_batch.h"
+#include "wav_player_priv.h"
+#include "esp_log.h"
+
+static const char *TAG = "wav_player_index";
+
+// File layout: header, records, then the NUL-terminated path of each record in record order
+#define INDEX_HEADER_SIZE 16
+#define INDEX_MIN_CAPACITY 16
+
+_Static_assert(sizeof(wav_player_index_entry_t) == 32, "index record must stay 32 bytes");
+
+struct wav_player_index {
+    wav_player_index_entry_t* entries;
+    char** paths;           // full path of each entry, confirms hash matches
+    uint8_t* seen;          // per-entry mark used by scan to drop removed files
+    size_t count;
+    size_t capacity;
+    uint32_t* slots;        // open addressing table of entry index + 1, 0 = empty
+    size_t slot_mask;
+};
+
+typedef struct {
+    struct wav_player_index* index;
+    char** paths;           // new or changed files to parse
+    struct stat* stats;     // stat of each pending file
+    size_t count;
+    size_t capacity;
+    size_t rescanned;
+} index_scan_t;
+
+#define INDEX_CHECKSUM_SEED 2166136261u
+
+static uint32_t index_checksum(uint32_t hash, const void* data, size_t size) {
+    const uint8_t *p = data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= p[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static wav_player_index_entry_t* index_find(struct wav_player_index* index, const char* path) {
+    if (index->slots == NULL) {
+        return NULL;
+    }
+
+    // Files whose paths share a hash sit further along the probe sequence
+    uint32_t hash = wav_player_hash_name(path);
+    for (size_t slot = hash & index->slot_mask; index->slots[slot] != 0;
+         slot = (slot + 1) & index->slot_mask) {
+        size_t i = index->slots[slot] - 1;
+        if (index->entries[i].path_hash == hash && strcmp(index->paths[i], path) == 0) {
+            return &index->entries[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Rebuild the hash table for the current entries
+ *
+ * The table is kept at most half full so probe sequences stay short.
+ */
+static esp_err_t index_rebuild_table(struct wav_player_index* index) {
+    size_t slot_count = INDEX_MIN_CAPACITY;
+    while (slot_count < index->count * 2) {
+        slot_count <<= 1;
+    }
+
+    uint32_t *slots = calloc(slot_count, sizeof(uint32_t));
+    if (slots == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    free(index->slots);
+    index->slots = slots;
+    index->slot_mask = slot_count - 1;
+
+    for (size_t i = 0; i < index->count; i++) {
+        size_t slot = index->entries[i].path_hash & index->slot_mask;
+        while (slots[slot] != 0) {
+            slot = (slot + 1) & index->slot_mask;
+        }
+        slots[slot] = i + 1;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t index_reserve(struct wav_player_index* index, size_t capacity) {
+    if (capacity <= index->capacity) {
+        return ESP_OK;
+    }
+
+    wav_player_index_entry_t *entries = realloc(index->entries, capacity * sizeof(*entries));
+    if (entries == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    index->entries = entries;
+
+    char **paths = realloc(index->paths, capacity * sizeof(char*));
+    if (paths == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    memset(paths + index->capacity, 0, (capacity - index->capacity) * sizeof(char*));
+    index->paths = paths;
+
+    uint8_t *seen = realloc(index->seen, capacity);
+    if (seen == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    memset(seen + index->capacity, 0, capacity - index->capacity);
+    index->seen = seen;
+
+    index->capacity = capacity;
+    return ESP_OK;
+}
+
+static esp_err_t index_check_file(const char* path, void* ctx) {
+    index_scan_t *scan = ctx;
+    struct wav_player_index *index = scan->index;
+
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        return ESP_OK;
+    }
+
+    wav_player_index_entry_t *entry = index_find(index, path);
+    if (entry != NULL && entry->mtime == (uint32_t)st.st_mtime &&
+        entry->file_size == (uint32_t)st.st_size) {
+        index->seen[entry - index->entries] = 1;
+        return ESP_OK;
+    }
+
+    // New or changed file, parse it later together with the others
+    if (scan->count == scan->capacity) {
+        size_t capacity = scan->capacity ? scan->capacity * 2 : INDEX_MIN_CAPACITY;
+        char **paths = realloc(scan->paths, capacity * sizeof(char*));
+        if (paths == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+        scan->paths = paths;
+        struct stat *stats = realloc(scan->stats, capacity * sizeof(struct stat));
+        if (stats == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+        scan->stats = stats;
+        scan->capacity = capacity;
+    }
+
+    scan->paths[scan->count] = strdup(path);
+    if (scan->paths[scan->count] == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    scan->stats[scan->count] = st;
+    scan->count++;
+    return ESP_OK;
+}
+
+static esp_err_t index_store(struct wav_player_index* index, const char* path,
+                             const wav_player_index_entry_t* record) {
+    wav_player_index_entry_t *entry = index_find(index, path);
+    if (entry != NULL) {
+        *entry = *record;
+        index->seen[entry - index->entries] = 1;
+        return ESP_OK;
+    }
+
+    if (index->count == index->capacity) {
+        size_t capacity = index->capacity ? index->capacity * 2 : INDEX_MIN_CAPACITY;
+        if (index_reserve(index, capacity) != ESP_OK) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    char *entry_path = strdup(path);
+    if (entry_path == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    index->entries[index->count] = *record;
+    index->paths[index->count] = entry_path;
+    index->seen[index->count] = 1;
+    index->count++;
+
+    if (index->count * 2 > index->slot_mask + 1) {
+        if (index_rebuild_table(index) != ESP_OK) {
+            index->count--;
+            free(entry_path);
+            index->paths[index->count] = NULL;
+            return ESP_ERR_NO_MEM;
+        }
+        return ESP_OK;
+    }
+
+    size_t slot = record->path_hash & index->slot_mask;
+    while (index->slots[slot] != 0) {
+        slot = (slot + 1) & index->slot_mask;
+    }
+    index->slots[slot] = index->count;
+    return ESP_OK;
+}
+
+/**
+ * @brief Parse all pending files in parallel and store their records
+ */
+static esp_err_t index_parse_pending(index_scan_t* scan) {
+    if (scan->count == 0) {
+        return ESP_OK;
+    }
+
+    wav_player_batch_info_t *results = calloc(scan->count, sizeof(wav_player_batch_info_t));
+    if (results == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t ret = wav_player_get_info_batch((const char* const*)scan->paths, scan->count, results, 0);
+    for (size_t i = 0; ret == ESP_OK && i < scan->count; i++) {
+        const wav_header_t *header = &results[i].header;
+        wav_player_index_entry_t record = {
+            .path_hash = wav_player_hash_name(scan->paths[i]),
+            .mtime = (uint32_t)scan->stats[i].st_mtime,
+            .file_size = (uint32_t)scan->stats[i].st_size,
+        };
+        if (results[i].err == ESP_OK) {
+            record.data_offset = results[i].data_offset;
+            record.data_size = header->data_size;
+            record.sample_rate = header->sample_rate;
+            record.duration_ms = results[i].duration_ms;
+            record.num_channels = header->num_channels;
+            record.bits_per_sample = header->bits_per_sample;
+            record.block_align = header->block_align;
+        } else {
+            // Recorded with block_align 0, so the file is not parsed again until it changes
+            ESP_LOGW(TAG, "Unsupported format: %s", scan->paths[i]);
+        }
+        ret = index_store(scan->index, scan->paths[i], &record);
+        scan->rescanned++;
+    }
+
+    free(results);
+    return ret;
+}
+
+/**
+ * @brief Read the path table that follows the records
+ *
+ * @return ESP_OK if every record got its path, ESP_ERR_NO_MEM if a path cannot
+ *         be allocated, ESP_FAIL if the table is corrupt
+ */
+static esp_err_t index_read_paths(struct wav_player_index* index, FILE* fp, size_t count,
+                                  size_t names_size, uint32_t checksum) {
+    char *names = malloc(names_size ? names_size : 1);
+    if (names == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (fread(names, 1, names_size, fp) != names_size ||
+        index_checksum(index_checksum(INDEX_CHECKSUM_SEED, index->entries,
+                                      count * sizeof(wav_player_index_entry_t)),
+                       names, names_size) != checksum) {
+        free(names);
+        return ESP_FAIL;
+    }
+
+    esp_err_t ret = ESP_OK;
+    size_t pos = 0;
+    for (size_t i = 0; ret == ESP_OK && i < count; i++) {
+        size_t len = strnlen(&names[pos], names_size - pos);
+        if (len == names_size - pos || index->entries[i].path_hash != wav_player_hash_name(&names[pos])) {
+            ret = ESP_FAIL;
+            break;
+        }
+        index->paths[i] = strdup(&names[pos]);
+        if (index->paths[i] == NULL) {
+            ret = ESP_ERR_NO_MEM;
+        }
+        pos += len + 1;
+    }
+    if (ret == ESP_OK && pos != names_size) {
+        ret = ESP_FAIL;
+    }
+    free(names);
+    return ret;
+}
+
+esp_err_t wav_player_index_load(const char* index_path, wav_player_index_handle_t* out_index) {
+    if (out_index == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    struct wav_player_index *index = calloc(1, sizeof(*index));
+    if (index == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    FILE *fp = index_path ? fopen(index_path, "rb") : NULL;
+    if (fp != NULL) {
+        uint8_t hdr[INDEX_HEADER_SIZE];
+        long file_size = -1;
+        if (fseek(fp, 0, SEEK_END) == 0) {
+            file_size = ftell(fp);
+        }
+        if (file_size >= INDEX_HEADER_SIZE && fseek(fp, 0, SEEK_SET) == 0 &&
+            fread(hdr, 1, sizeof(hdr), fp) == sizeof(hdr) &&
+            memcmp(hdr, WAV_PLAYER_INDEX_MAGIC, 4) == 0 &&
+            read_le16(&hdr[4]) == WAV_PLAYER_INDEX_VERSION &&
+            read_le16(&hdr[6]) == sizeof(wav_player_index_entry_t)) {
+            size_t count = read_le32(&hdr[8]);
+            uint32_t checksum = read_le32(&hdr[12]);
+
+            // A corrupt count must not size the allocation, the file holds count records and their paths
+            uint64_t records_size = (uint64_t)count * sizeof(wav_player_index_entry_t);
+            uint64_t names_size = (uint64_t)file_size - INDEX_HEADER_SIZE - records_size;
+            bool valid = records_size <= (uint64_t)file_size - INDEX_HEADER_SIZE &&
+                         names_size >= count && names_size <= (uint64_t)count * WAV_PLAYER_MAX_PATH;
+            if (valid && index_reserve(index, count > 0 ? count : INDEX_MIN_CAPACITY) != ESP_OK) {
+                fclose(fp);
+                wav_player_index_free(index);
+                return ESP_ERR_NO_MEM;
+            }
+            esp_err_t ret = ESP_FAIL;
+            if (valid && fread(index->entries, sizeof(wav_player_index_entry_t), count, fp) == count) {
+                ret = index_read_paths(index, fp, count, names_size, checksum);
+            }
+            if (ret == ESP_OK) {
+                index->count = count;
+            } else {
+                for (size_t i = 0; i < count && index->paths != NULL; i++) {
+                    free(index->paths[i]);
+                    index->paths[i] = NULL;
+                }
+                if (ret == ESP_ERR_NO_MEM) {
+                    fclose(fp);
+                    wav_player_index_free(index);
+                    return ESP_ERR_NO_MEM;
+                }
+                ESP_LOGW(TAG, "Index %s is corrupt, starting empty", index_path);
+            }
+        } else {
+            ESP_LOGW(TAG, "Index %s has an unknown format, starting empty", index_path);
+        }
+        fclose(fp);
+    }
+
+    if (index_rebuild_table(index) != ESP_OK) {
+        wav_player_index_free(index);
+        return ESP_ERR_NO_MEM;
+    }
+
+    *out_index = index;
+    return ESP_OK;
+}
+
+esp_err_t wav_player_index_scan(wav_player_index_handle_t index, const char* dir, size_t* rescanned) {
+    if (index == NULL || dir == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (index->capacity > 0) {
+        memset(index->seen, 0, index->capacity);
+    }
+
+    index_scan_t scan = {
+        .index = index,
+    };
+    esp_err_t ret = wav_player_walk_dir(dir, index_check_file, &scan);
+    if (ret == ESP_OK) {
+        ret = index_parse_pending(&scan);
+    }
+    for (size_t i = 0; i < scan.count; i++) {
+        free(scan.paths[i]);
+    }
+    free(scan.paths);
+    free(scan.stats);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    // Drop records of files that were not found
+    size_t kept = 0;
+    for (size_t i = 0; i < index->count; i++) {
+        if (index->seen[i]) {
+            index->paths[kept] = index->paths[i];
+            index->entries[kept++] = index->entries[i];
+        } else {
+            free(index->paths[i]);
+        }
+    }
+    if (kept != index->count) {
+        memset(&index->paths[kept], 0, (index->count - kept) * sizeof(char*));
+        index->count = kept;
+        ret = index_rebuild_table(index);
+    }
+
+    ESP_LOGI(TAG, "Indexed %u files in %s, %u re-parsed",
+             (unsigned)index->count, dir, (unsigned)scan.rescanned);
+    if (rescanned != NULL) {
+        *rescanned = scan.rescanned;
+    }
+    return ret;
+}
+
+esp_err_t wav_player_index_save(wav_player_index_handle_t index, const char* index_path) {
+    if (index == NULL || index_path == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    char tmp_path[WAV_PLAYER_MAX_PATH];
+    if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", index_path) >= (int)sizeof(tmp_path)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    FILE *fp = fopen(tmp_path, "wb");
+    if (fp == NULL) {
+        ESP_LOGE(TAG, "Failed to create %s", tmp_path);
+        return ESP_FAIL;
+    }
+
+    size_t records_size = index->count * sizeof(wav_player_index_entry_t);
+    uint32_t count = index->count;
+    uint32_t checksum = index_checksum(INDEX_CHECKSUM_SEED, index->entries, records_size);
+    for (size_t i = 0; i < index->count; i++) {
+        checksum = index_checksum(checksum, index->paths[i], strlen(index->paths[i]) + 1);
+    }
+    uint8_t hdr[INDEX_HEADER_SIZE] = {
+        'W', 'I', 'D', 'X',
+        WAV_PLAYER_INDEX_VERSION & 0xFF, WAV_PLAYER_INDEX_VERSION >> 8,
+        sizeof(wav_player_index_entry_t), 0,
+        count & 0xFF, (count >> 8) & 0xFF, (count >> 16) & 0xFF, count >> 24,
+        checksum & 0xFF, (checksum >> 8) & 0xFF, (checksum >> 16) & 0xFF, checksum >> 24,
+    };
+
+    bool ok = fwrite(hdr, 1, sizeof(hdr), fp) == sizeof(hdr) &&
+              (records_size == 0 || fwrite(index->entries, 1, records_size, fp) == records_size);
+    for (size_t i = 0; ok && i < index->count; i++) {
+        size_t len = strlen(index->paths[i]) + 1;
+        ok = fwrite(index->paths[i], 1, len, fp) == len;
+    }
+    ok = (fclose(fp) == 0) && ok;
+    if (!ok) {
+        ESP_LOGE(TAG, "Failed to write %s", tmp_path);
+        remove(tmp_path);
+        return ESP_FAIL;
+    }
+
+    // FAT rename does not replace an existing file
+    remove(index_path);
+    if (rename(tmp_path, index_path) != 0) {
+        ESP_LOGE(TAG, "Failed to rename %s", tmp_path);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+const wav_player_index_entry_t* wav_player_index_lookup(wav_player_index_handle_t index, const char* filepath) {
+    if (index == NULL || filepath == NULL) {
+        return NULL;
+    }
+    const wav_player_index_entry_t *entry = index_find(index, filepath);
+    return entry != NULL && entry->block_align != 0 ? entry : NULL;
+}
+
+esp_err_t wav_player_index_get_info(wav_player_index_handle_t index, const char* filepath, wav_header_t* header) {
+    if (index == NULL || filepath == NULL || header == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    const wav_player_index_entry_t *entry = wav_player_index_lookup(index, filepath);
+    if (entry == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    header->num_channels = entry->num_channels;
+    header->sample_rate = entry->sample_rate;
+    header->bits_per_sample = entry->bits_per_sample;
+    header->data_size = entry->data_size;
+    header->block_align = entry->block_align;
+    return ESP_OK;
+}
+
+size_t wav_player_index_count(wav_player_index_handle_t index) {
+    size_t count = 0;
+    for (size_t i = 0; index != NULL && i < index->count; i++) {
+        count += index->entries[i].block_align != 0;
+    }
+    return count;
+}
+
+void wav_player_index_free(wav_player_index_handle_t index) {
+    if (index == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; i < index->count; i++) {
+        free(index->paths[i]);
+    }
+    free(index->slots);
+    free(index->paths);
+    free(index->seen);
+    free(index->entries);
+    free(index);
+}
@@ -0,0 +1,210 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "wav_player_loop.h"
+#include "wav_player_priv.h"
+#include "esp_log.h"
+
+static const char *TAG = "wav_player_loop";
+
+/** Bytes of the loop start kept in RAM, several blocks of any format */
+#define LOOP_HEAD_SIZE 6144
+
+/** Size of the smpl chunk header and of one loop record */
+#define SMPL_HEADER_SIZE 36
+#define SMPL_LOOP_SIZE 24
+
+typedef struct {
+    wav_source_t inner;
+    uint32_t start;             // loop region in bytes of PCM data
+    uint32_t end;
+    uint32_t jumps_left;        // jumps back still to take
+    bool forever;
+    uint32_t pos;               // byte position in the PCM data
+    bool wrapped;               // the loop start is served from head
+    uint8_t* head;              // first head_len bytes of the loop
+    uint32_t head_len;
+    esp_err_t error;            // failure to seek back, reads of inner report their own
+} loop_source_t;
+
+static size_t loop_source_read(void* ctx, void* dst, size_t size) {
+    loop_source_t *src = ctx;
+    uint8_t *out = dst;
+    size_t total = 0;
+
+    while (total < size) {
+        if (src->pos == src->end && (src->forever || src->jumps_left > 0)) {
+            // The seam is filled from RAM while storage resumes behind the head
+            if (src->inner.ops->seek(src->inner.ctx, src->start + src->head_len) != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to seek back to the loop");
+                src->error = ESP_FAIL;
+                break;
+            }
+            src->pos = src->start;
+            src->wrapped = true;
+            if (!src->forever) {
+                src->jumps_left--;
+            }
+        }
+
+        size_t n = size - total;
+        if ((src->forever || src->jumps_left > 0) && src->pos < src->end && n > src->end - src->pos) {
+            n = src->end - src->pos;
+        }
+        if (src->wrapped && src->pos >= src->start && src->pos < src->start + src->head_len) {
+            if (n > src->start + src->head_len - src->pos) {
+                n = src->start + src->head_len - src->pos;
+            }
+            memcpy(&out[total], &src->head[src->pos - src->start], n);
+        } else {
+            n = src->inner.ops->read(src->inner.ctx, &out[total], n);
+            if (n == 0) {
+                break;
+            }
+        }
+        src->pos += n;
+        total += n;
+    }
+    return total;
+}
+
+static esp_err_t loop_source_error(void* ctx) {
+    loop_source_t *src = ctx;
+    return src->error != ESP_OK ? src->error : wav_source_error(&src->inner);
+}
+
+static void loop_source_close(void* ctx) {
+    loop_source_t *src = ctx;
+    free(src->head);
+    free(src);
+}
+
+static const wav_source_ops_t loop_source_ops = {
+    .read = loop_source_read,
+    .close = loop_source_close,
+    .error = loop_source_error,
+};
+
+esp_err_t wav_loop_source_create(wav_source_t* inner, const wav_player_info_t* info,
+                                 const wav_player_loop_t* loop, wav_source_t* looped) {
+    if (loop->start_frame >= loop->end_frame || loop->end_frame > info->frame_count) {
+        ESP_LOGE(TAG, "Invalid loop %lu-%lu in %lu frames", loop->start_frame, loop->end_frame,
+                 info->frame_count);
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (inner->ops->seek == NULL) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    uint16_t block_align = info->header.block_align;
+    loop_source_t *src = calloc(1, sizeof(*src));
+    if (src == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    src->inner = *inner;
+    src->start = loop->start_frame * block_align;
+    src->end = loop->end_frame * block_align;
+    src->forever = loop->count == 0;
+    src->jumps_left = loop->count > 0 ? loop->count - 1 : 0;
+    src->head_len = LOOP_HEAD_SIZE / block_align * block_align;
+    if (src->head_len > src->end - src->start) {
+        src->head_len = src->end - src->start;
+    }
+    src->head = malloc(src->head_len);
+    if (src->head == NULL) {
+        free(src);
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Buffer the loop start now, then rewind to the first frame
+    uint32_t filled = 0;
+    if (inner->ops->seek(inner->ctx, src->start) == ESP_OK) {
+        while (filled < src->head_len) {
+            size_t n = inner->ops->read(inner->ctx, &src->head[filled], src->head_len - filled);
+            if (n == 0) {
+                break;
+            }
+            filled += n;
+        }
+    }
+    if (filled < src->head_len || inner->ops->seek(inner->ctx, 0) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to buffer the loop start");
+        loop_source_close(src);
+        return ESP_FAIL;
+    }
+
+    looped->ops = &loop_source_ops;
+    looped->ctx = src;
+    looped->block_size = inner->block_size;
+    return ESP_OK;
+}
+
+esp_err_t wav_loop_read_smpl(FILE* fp, uint32_t offset, uint32_t size, wav_player_loop_t* loop) {
+    uint8_t body[SMPL_HEADER_SIZE + SMPL_LOOP_SIZE];
+    if (size < sizeof(body) || fseek(fp, offset, SEEK_SET) != 0 ||
+        fread(body, 1, sizeof(body), fp) != sizeof(body) || read_le32(&body[28]) == 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    // smpl loop ends are inclusive, a play count of 0 means forever
+    const uint8_t *record = &body[SMPL_HEADER_SIZE];
+    loop->start_frame = read_le32(&record[8]);
+    loop->end_frame = read_le32(&record[12]) + 1;
+    loop->count = read_le32(&record[20]);
+    return ESP_OK;
+}
+
+esp_err_t wav_player_get_loop(const char* filepath, wav_player_loop_t* loop) {
+    if (filepath == NULL || loop == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    wav_open_file_t file;
+    if (wav_open_file(filepath, true, &file) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    if (file.meta->has_loop) {
+        *loop = file.meta->loop;
+        ret = ESP_OK;
+    }
+    wav_close_file(&file);
+    return ret;
+}
+
+esp_err_t wav_player_play_file_loop(const char* filepath, const wav_player_loop_t* loop,
+                                    wav_player_write_cb_t write_cb, void* user_data) {
+    if (filepath == NULL || write_cb == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Without a region the smpl chunk is read from the file being played
+    wav_open_file_t file;
+    if (wav_open_file(filepath, loop == NULL, &file) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    if (loop == NULL && !file.meta->has_loop) {
+        wav_close_file(&file);
+        return ESP_ERR_NOT_FOUND;
+    }
+    wav_player_loop_t region = loop != NULL ? *loop : file.meta->loop;
+
+    wav_source_t looped;
+    esp_err_t ret = wav_loop_source_create(&file.source, &file.info, &region, &looped);
+    if (ret == ESP_OK) {
+        ESP_LOGI(TAG, "Looping %s: frames %lu-%lu, %lu times", filepath,
+                 region.start_frame, region.end_frame, region.count);
+        ret = wav_player_play_source(&looped, &file.info.header, write_cb, user_data);
+        looped.ops->close(looped.ctx);
+    }
+    wav_close_file(&file);
+    return ret;
+}
+
+esp_err_t wav_player_open_loop(const char* filepath, const wav_player_loop_t* loop,
+                               wav_player_handle_t* handle) {
+    if (filepath == NULL || handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return wav_handle_open(filepath, true, loop, handle);
+}
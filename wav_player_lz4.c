@@ -0,0 +1,410 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "wav_player_lz4.h"
+#include "wav_player_priv.h"
+#include "esp_log.h"
+
+static const char *TAG = "wav_player_lz4";
+
+#define LZ4_HEADER_SIZE 28
+#define LZ4_MIN_MATCH 4
+
+typedef struct {
+    FILE* fp;
+    wav_header_t header;
+    uint32_t block_size;
+    uint32_t block_count;
+    uint32_t* offsets;      // block_count + 1 absolute file offsets
+    uint8_t* packed;        // compressed block staging buffer
+    uint8_t* block;         // decompressed block for reads not aligned to blocks
+    uint32_t next_block;    // next block to decode
+    size_t block_len;       // valid bytes in block
+    size_t block_pos;       // consumed bytes in block
+    long file_pos;          // current file position, avoids redundant fseek
+    esp_err_t error;        // failure that ended reads early
+} lz4_source_t;
+
+/**
+ * @brief Decompress a raw LZ4 block
+ *
+ * Bounds-checked decoder for the LZ4 block format, never reads past the input
+ * nor writes past the output buffer.
+ *
+ * @param src Compressed data
+ * @param src_len Size of compressed data
+ * @param dst Output buffer
+ * @param dst_cap Capacity of the output buffer
+ * @return Number of decompressed bytes, or -1 if the block is malformed
+ */
+static int lz4_decompress_block(const uint8_t* src, size_t src_len, uint8_t* dst, size_t dst_cap) {
+    const uint8_t *ip = src;
+    const uint8_t *iend = src + src_len;
+    uint8_t *op = dst;
+    uint8_t *oend = dst + dst_cap;
+
+    while (ip < iend) {
+        uint8_t token = *ip++;
+
+        size_t literals = token >> 4;
+        if (literals == 15) {
+            uint8_t b;
+            do {
+                if (ip >= iend) {
+                    return -1;
+                }
+                b = *ip++;
+                literals += b;
+            } while (b == 255);
+        }
+        if ((size_t)(iend - ip) < literals || (size_t)(oend - op) < literals) {
+            return -1;
+        }
+        memcpy(op, ip, literals);
+        op += literals;
+        ip += literals;
+
+        // The last sequence carries literals only
+        if (ip >= iend) {
+            break;
+        }
+
+        if (iend - ip < 2) {
+            return -1;
+        }
+        size_t offset = read_le16(ip);
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - dst)) {
+            return -1;
+        }
+
+        size_t match_len = token & 0x0F;
+        if (match_len == 15) {
+            uint8_t b;
+            do {
+                if (ip >= iend) {
+                    return -1;
+                }
+                b = *ip++;
+                match_len += b;
+            } while (b == 255);
+        }
+        match_len += LZ4_MIN_MATCH;
+        if ((size_t)(oend - op) < match_len) {
+            return -1;
+        }
+
+        const uint8_t *match = op - offset;
+        if (offset >= match_len) {
+            memcpy(op, match, match_len);
+            op += match_len;
+        } else {
+            // Overlapping copy repeats the last offset bytes
+            for (size_t i = 0; i < match_len; i++) {
+                *op++ = *match++;
+            }
+        }
+    }
+
+    return op - dst;
+}
+
+static inline size_t lz4_block_raw_len(const lz4_source_t* src, uint32_t index) {
+    size_t start = (size_t)index * src->block_size;
+    size_t remaining = src->header.data_size - start;
+    return remaining < src->block_size ? remaining : src->block_size;
+}
+
+/**
+ * @brief Read and decompress one block into dst
+ *
+ * @return ESP_OK on success, ESP_FAIL on I/O error or corrupt block
+ */
+static esp_err_t lz4_decode_block(lz4_source_t* src, uint32_t index, uint8_t* dst) {
+    uint32_t offset = src->offsets[index];
+    size_t packed_len = src->offsets[index + 1] - offset;
+    size_t raw_len = lz4_block_raw_len(src, index);
+
+    if (packed_len > raw_len) {
+        ESP_LOGE(TAG, "Block %lu too large: %u bytes", index, (unsigned)packed_len);
+        return ESP_FAIL;
+    }
+
+    if (src->file_pos != (long)offset) {
+        if (fseek(src->fp, offset, SEEK_SET) != 0) {
+            ESP_LOGE(TAG, "Failed to seek to block %lu", index);
+            return ESP_FAIL;
+        }
+        src->file_pos = offset;
+    }
+
+    // Incompressible blocks are stored raw and read straight into dst
+    uint8_t *target = (packed_len == raw_len) ? dst : src->packed;
+    if (fread(target, 1, packed_len, src->fp) != packed_len) {
+        ESP_LOGE(TAG, "Failed to read block %lu", index);
+        src->file_pos = -1;
+        return ESP_FAIL;
+    }
+    src->file_pos += packed_len;
+
+    if (target == src->packed &&
+        lz4_decompress_block(src->packed, packed_len, dst, raw_len) != (int)raw_len) {
+        ESP_LOGE(TAG, "Corrupt block %lu", index);
+        return ESP_FAIL;
+    }
+
+    return ESP_OK;
+}
+
+static size_t lz4_source_read(void* ctx, void* dst, size_t size) {
+    lz4_source_t *src = ctx;
+    uint8_t *out = dst;
+    size_t total = 0;
+
+    while (total < size) {
+        if (src->block_pos < src->block_len) {
+            size_t n = src->block_len - src->block_pos;
+            if (n > size - total) {
+                n = size - total;
+            }
+            memcpy(out + total, src->block + src->block_pos, n);
+            src->block_pos += n;
+            total += n;
+            if (src->block_pos == src->block_len) {
+                // Short read realigns the caller to block boundaries after a seek
+                break;
+            }
+            continue;
+        }
+
+        if (src->next_block >= src->block_count) {
+            break;
+        }
+
+        uint32_t index = src->next_block;
+        size_t raw_len = lz4_block_raw_len(src, index);
+
+        if (size - total >= raw_len) {
+            // Whole block fits, decompress directly into the caller's buffer
+            if (lz4_decode_block(src, index, out + total) != ESP_OK) {
+                src->error = ESP_FAIL;
+                break;
+            }
+            total += raw_len;
+        } else {
+            if (src->block == NULL) {
+                src->block = malloc(src->block_size);
+                if (src->block == NULL) {
+                    ESP_LOGE(TAG, "Failed to allocate block buffer");
+                    src->error = ESP_ERR_NO_MEM;
+                    break;
+                }
+            }
+            if (lz4_decode_block(src, index, src->block) != ESP_OK) {
+                src->error = ESP_FAIL;
+                break;
+            }
+            src->block_len = raw_len;
+            src->block_pos = 0;
+        }
+        src->next_block++;
+    }
+
+    return total;
+}
+
+static esp_err_t lz4_source_seek(void* ctx, uint32_t offset) {
+    lz4_source_t *src = ctx;
+
+    if (offset > src->header.data_size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    src->next_block = offset / src->block_size;
+    src->block_len = 0;
+    src->block_pos = 0;
+    src->error = ESP_OK;
+
+    size_t skip = offset % src->block_size;
+    if (skip == 0) {
+        return ESP_OK;
+    }
+
+    // Decode the block containing the offset and skip to it
+    if (src->block == NULL) {
+        src->block = malloc(src->block_size);
+        if (src->block == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    if (lz4_decode_block(src, src->next_block, src->block) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    src->block_len = lz4_block_raw_len(src, src->next_block);
+    src->block_pos = skip;
+    src->next_block++;
+    return ESP_OK;
+}
+
+static esp_err_t lz4_source_error(void* ctx) {
+    lz4_source_t *src = ctx;
+    return src->error;
+}
+
+static const wav_source_ops_t lz4_source_ops = {
+    .read = lz4_source_read,
+    .seek = lz4_source_seek,
+    .error = lz4_source_error,
+};
+
+/**
+ * @brief Read and check the container header
+ *
+ * @param fp Open container file positioned at the start
+ * @param src Source to fill with format and block geometry
+ * @return ESP_OK on success, ESP_FAIL if the header is invalid
+ */
+static esp_err_t lz4_read_header(FILE* fp, lz4_source_t* src) {
+    uint8_t hdr[LZ4_HEADER_SIZE];
+
+    if (fread(hdr, 1, sizeof(hdr), fp) != sizeof(hdr)) {
+        ESP_LOGE(TAG, "Failed to read container header");
+        return ESP_FAIL;
+    }
+    if (memcmp(hdr, WAV_PLAYER_LZ4_MAGIC, 4) != 0 || read_le16(&hdr[4]) != WAV_PLAYER_LZ4_VERSION) {
+        ESP_LOGE(TAG, "Not an LZ4 PCM container");
+        return ESP_FAIL;
+    }
+
+    src->header.num_channels = read_le16(&hdr[6]);
+    src->header.sample_rate = read_le32(&hdr[8]);
+    src->header.bits_per_sample = read_le16(&hdr[12]);
+    src->header.block_align = read_le16(&hdr[14]);
+    src->header.data_size = read_le32(&hdr[16]);
+    src->block_size = read_le32(&hdr[20]);
+    src->block_count = read_le32(&hdr[24]);
+
+    if (!is_valid_wav_header(&src->header)) {
+        return ESP_FAIL;
+    }
+    if (src->block_size == 0 || src->block_size % src->header.block_align != 0 ||
+        src->block_count != src->header.data_size / src->block_size +
+                            (src->header.data_size % src->block_size != 0)) {
+        ESP_LOGE(TAG, "Invalid block geometry: block_size=%lu, block_count=%lu",
+                 src->block_size, src->block_count);
+        return ESP_FAIL;
+    }
+
+    return ESP_OK;
+}
+
+static void lz4_source_close(lz4_source_t* src) {
+    free(src->block);
+    free(src->packed);
+    free(src->offsets);
+    if (src->fp != NULL) {
+        fclose(src->fp);
+    }
+}
+
+static esp_err_t lz4_source_open(const char* filepath, lz4_source_t* src) {
+    memset(src, 0, sizeof(*src));
+
+    src->fp = fopen(filepath, "rb");
+    if (src->fp == NULL) {
+        ESP_LOGE(TAG, "Failed to open file %s", filepath);
+        return ESP_FAIL;
+    }
+
+    esp_err_t ret = lz4_read_header(src->fp, src);
+    if (ret != ESP_OK) {
+        lz4_source_close(src);
+        return ret;
+    }
+
+    size_t table_len = ((size_t)src->block_count + 1) * sizeof(uint32_t);
+    src->offsets = malloc(table_len);
+    src->packed = malloc(src->block_size);
+    if (src->offsets == NULL || src->packed == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate block table");
+        lz4_source_close(src);
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (fread(src->offsets, 1, table_len, src->fp) != table_len) {
+        ESP_LOGE(TAG, "Failed to read block table");
+        lz4_source_close(src);
+        return ESP_FAIL;
+    }
+    for (uint32_t i = 0; i <= src->block_count; i++) {
+        src->offsets[i] = read_le32((const uint8_t*)&src->offsets[i]);
+        if (i > 0 && src->offsets[i] < src->offsets[i - 1]) {
+            ESP_LOGE(TAG, "Corrupt block table");
+            lz4_source_close(src);
+            return ESP_FAIL;
+        }
+    }
+    src->file_pos = ftell(src->fp);
+
+    return ESP_OK;
+}
+
+esp_err_t wav_player_lz4_get_info(const char* filepath, wav_header_t* header) {
+    FILE* fp = fopen(filepath, "rb");
+    if (fp == NULL) {
+        ESP_LOGE(TAG, "Failed to open file %s", filepath);
+        return ESP_FAIL;
+    }
+
+    lz4_source_t src = {0};
+    esp_err_t ret = lz4_read_header(fp, &src);
+    fclose(fp);
+    if (ret == ESP_OK) {
+        *header = src.header;
+    }
+    return ret;
+}
+
+esp_err_t wav_player_play_lz4(const char* filepath, uint32_t start_frame,
+                              wav_player_write_cb_t write_cb, void* user_data) {
+    if (write_cb == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    lz4_source_t src;
+    esp_err_t ret = lz4_source_open(filepath, &src);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    uint64_t start_offset = (uint64_t)start_frame * src.header.block_align;
+    if (start_offset > src.header.data_size) {
+        ESP_LOGE(TAG, "Start frame %lu past end of data", start_frame);
+        lz4_source_close(&src);
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (start_offset > 0) {
+        ret = lz4_source_seek(&src, (uint32_t)start_offset);
+        if (ret != ESP_OK) {
+            lz4_source_close(&src);
+            return ret;
+        }
+    }
+
+    ESP_LOGI(TAG, "LZ4 file info: channels=%d, sample_rate=%lu, bits_per_sample=%d, block_size=%lu, blocks=%lu",
+             src.header.num_channels,
+             src.header.sample_rate,
+             src.header.bits_per_sample,
+             src.block_size,
+             src.block_count);
+
+    wav_source_t source = {
+        .ops = &lz4_source_ops,
+        .ctx = &src,
+        .block_size = src.block_size,
+    };
+    ret = wav_player_play_source(&source, &src.header, write_cb, user_data);
+
+    lz4_source_close(&src);
+    return ret;
+}
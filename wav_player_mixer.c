@@ -0,0 +1,191 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "wav_player_mixer.h"
+#include "wav_player_priv.h"
+#include "esp_log.h"
+
+static const char *TAG = "wav_player_mixer";
+
+/** Frames mixed per pass over the voices */
+#define MIXER_CHUNK_FRAMES 256
+
+typedef struct {
+    wav_player_handle_t handle;     // NULL when the voice is free
+    uint64_t start_frame;
+} mixer_voice_t;
+
+struct wav_player_mixer {
+    pthread_mutex_t lock;           // voices and clock, never held across file I/O
+    pthread_mutex_t read_lock;      // serializes mixing, which owns scratch
+    uint32_t sample_rate;
+    uint64_t frame;                 // next output frame, advanced when a read starts mixing
+    mixer_voice_t voices[WAV_PLAYER_MIXER_MAX_VOICES];
+    int16_t scratch[MIXER_CHUNK_FRAMES * 2];
+};
+
+esp_err_t wav_player_mixer_create(uint32_t sample_rate, wav_player_mixer_t* mixer) {
+    if (mixer == NULL || sample_rate == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    wav_player_mixer_t m = calloc(1, sizeof(*m));
+    if (m == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    pthread_mutex_init(&m->lock, NULL);
+    pthread_mutex_init(&m->read_lock, NULL);
+    m->sample_rate = sample_rate;
+    *mixer = m;
+    return ESP_OK;
+}
+
+esp_err_t wav_player_mixer_schedule(wav_player_mixer_t m, const char* filepath, uint64_t start_frame) {
+    if (m == NULL || filepath == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Parse the file outside the lock, the mixer keeps running meanwhile
+    wav_player_handle_t handle;
+    esp_err_t ret = wav_player_open(filepath, &handle);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    wav_player_info_t info;
+    wav_player_handle_get_info(handle, &info);
+    if (info.header.sample_rate != m->sample_rate) {
+        ESP_LOGE(TAG, "%s: sample rate %lu, mixer runs at %lu", filepath,
+                 info.header.sample_rate, m->sample_rate);
+        wav_player_close(handle);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&m->lock);
+    mixer_voice_t *voice = NULL;
+    for (size_t i = 0; i < WAV_PLAYER_MIXER_MAX_VOICES; i++) {
+        if (m->voices[i].handle == NULL) {
+            voice = &m->voices[i];
+            break;
+        }
+    }
+    if (voice != NULL) {
+        voice->handle = handle;
+        voice->start_frame = start_frame;
+    }
+    pthread_mutex_unlock(&m->lock);
+
+    if (voice == NULL) {
+        ESP_LOGW(TAG, "All %d voices busy, dropping %s", WAV_PLAYER_MIXER_MAX_VOICES, filepath);
+        wav_player_close(handle);
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+static inline int16_t saturate(int32_t sample) {
+    if (sample > INT16_MAX) {
+        return INT16_MAX;
+    }
+    if (sample < INT16_MIN) {
+        return INT16_MIN;
+    }
+    return sample;
+}
+
+/**
+ * @brief Add a voice into a chunk starting at output frame
+ *
+ * @return false once the voice has ended
+ */
+static bool mix_voice(wav_player_mixer_t m, const mixer_voice_t* voice, uint64_t frame,
+                      int16_t* out, size_t frames) {
+    // Start at the exact frame, which may lie inside this chunk
+    size_t offset = 0;
+    if (voice->start_frame > frame) {
+        if (voice->start_frame - frame >= frames) {
+            return true;
+        }
+        offset = voice->start_frame - frame;
+    }
+
+    size_t n;
+    if (wav_player_read(voice->handle, m->scratch, frames - offset, &n) != ESP_OK) {
+        return false;
+    }
+    int16_t *dst = &out[offset * 2];
+    for (size_t i = 0; i < n * 2; i++) {
+        dst[i] = saturate((int32_t)dst[i] + m->scratch[i]);
+    }
+    return n == frames - offset;
+}
+
+esp_err_t wav_player_mixer_read(wav_player_mixer_t m, int16_t* out, size_t frames) {
+    if (m == NULL || (out == NULL && frames > 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(out, 0, frames * WAV_PLAYER_OUT_FRAME_BYTES);
+
+    // Mix a snapshot of the voices, so scheduling and the clock never wait for storage
+    pthread_mutex_lock(&m->read_lock);
+    pthread_mutex_lock(&m->lock);
+    mixer_voice_t voices[WAV_PLAYER_MIXER_MAX_VOICES];
+    memcpy(voices, m->voices, sizeof(voices));
+    uint64_t frame = m->frame;
+    // Clips scheduled from now on start at or after the end of this read
+    m->frame += frames;
+    pthread_mutex_unlock(&m->lock);
+
+    wav_player_handle_t ended[WAV_PLAYER_MIXER_MAX_VOICES];
+    size_t ended_count = 0;
+    while (frames > 0) {
+        size_t chunk = frames < MIXER_CHUNK_FRAMES ? frames : MIXER_CHUNK_FRAMES;
+        for (size_t i = 0; i < WAV_PLAYER_MIXER_MAX_VOICES; i++) {
+            mixer_voice_t *voice = &voices[i];
+            if (voice->handle != NULL && !mix_voice(m, voice, frame, out, chunk)) {
+                ended[ended_count++] = voice->handle;
+                voice->handle = NULL;
+            }
+        }
+        frame += chunk;
+        out += chunk * 2;
+        frames -= chunk;
+    }
+
+    // Voices scheduled meanwhile took free slots only, ended ones are found by handle
+    pthread_mutex_lock(&m->lock);
+    for (size_t i = 0; i < WAV_PLAYER_MIXER_MAX_VOICES; i++) {
+        for (size_t j = 0; j < ended_count; j++) {
+            if (m->voices[i].handle == ended[j]) {
+                m->voices[i].handle = NULL;
+            }
+        }
+    }
+    pthread_mutex_unlock(&m->lock);
+    pthread_mutex_unlock(&m->read_lock);
+
+    for (size_t j = 0; j < ended_count; j++) {
+        wav_player_close(ended[j]);
+    }
+    return ESP_OK;
+}
+
+uint64_t wav_player_mixer_get_frame(wav_player_mixer_t m) {
+    pthread_mutex_lock(&m->lock);
+    uint64_t frame = m->frame;
+    pthread_mutex_unlock(&m->lock);
+    return frame;
+}
+
+void wav_player_mixer_delete(wav_player_mixer_t m) {
+    if (m == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < WAV_PLAYER_MIXER_MAX_VOICES; i++) {
+        wav_player_close(m->voices[i].handle);
+    }
+    pthread_mutex_destroy(&m->read_lock);
+    pthread_mutex_destroy(&m->lock);
+    free(m);
+}
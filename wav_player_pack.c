@@ -0,0 +1,253 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "wav_player_pack.h"
+#include "wav_player_priv.h"
+#include "esp_log.h"
+
+static const char *TAG = "wav_player_pack";
+
+#define PACK_HEADER_SIZE 12
+#define PACK_ENTRY_SIZE 28
+#define PACK_MAX_NAME 256       // bounds the name table a directory may declare
+
+typedef struct {
+    uint32_t name_hash;
+    uint32_t data_offset;
+    wav_header_t header;
+    uint32_t name_offset;       // offset of the NUL-terminated name in the name table
+} pack_entry_t;
+
+struct wav_player_pack {
+    FILE* fp;
+    pthread_mutex_t lock;       // serializes seek + read on the shared handle
+    long file_pos;              // current file position, avoids redundant fseek
+    uint16_t entry_count;
+    pack_entry_t* entries;      // sorted by name_hash
+    char* names;                // name table, NUL-terminated names
+};
+
+typedef struct {
+    struct wav_player_pack* pack;
+    const pack_entry_t* entry;
+    uint32_t pos;               // read position within the clip data
+    esp_err_t error;            // failure that ended reads early
+} pack_source_t;
+
+static const pack_entry_t* pack_find(const struct wav_player_pack* pack, const char* name) {
+    uint32_t hash = wav_player_hash_name(name);
+    size_t lo = 0;
+    size_t hi = pack->entry_count;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        uint32_t mid_hash = pack->entries[mid].name_hash;
+        if (mid_hash == hash) {
+            // Hashes are unique within a pack, the name tells a miss from a collision
+            const pack_entry_t *entry = &pack->entries[mid];
+            return strcmp(&pack->names[entry->name_offset], name) == 0 ? entry : NULL;
+        }
+        if (mid_hash < hash) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return NULL;
+}
+
+static size_t pack_source_read(void* ctx, void* dst, size_t size) {
+    pack_source_t *src = ctx;
+    struct wav_player_pack *pack = src->pack;
+
+    size_t remaining = src->entry->header.data_size - src->pos;
+    if (size > remaining) {
+        size = remaining;
+    }
+    if (size == 0) {
+        return 0;
+    }
+
+    long offset = (long)src->entry->data_offset + src->pos;
+    size_t bytes_read = 0;
+
+    pthread_mutex_lock(&pack->lock);
+    if (pack->file_pos == offset || fseek(pack->fp, offset, SEEK_SET) == 0) {
+        bytes_read = fread(dst, 1, size, pack->fp);
+        pack->file_pos = offset + bytes_read;
+    } else {
+        ESP_LOGE(TAG, "Failed to seek to offset %ld", offset);
+        pack->file_pos = -1;
+    }
+    pthread_mutex_unlock(&pack->lock);
+
+    src->pos += bytes_read;
+    if (bytes_read < size) {
+        src->error = ESP_FAIL;
+    }
+    return bytes_read;
+}
+
+static esp_err_t pack_source_seek(void* ctx, uint32_t offset) {
+    pack_source_t *src = ctx;
+
+    if (offset > src->entry->header.data_size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    src->pos = offset;
+    src->error = ESP_OK;
+    return ESP_OK;
+}
+
+static esp_err_t pack_source_error(void* ctx) {
+    pack_source_t *src = ctx;
+    return src->error;
+}
+
+static const wav_source_ops_t pack_source_ops = {
+    .read = pack_source_read,
+    .seek = pack_source_seek,
+    .error = pack_source_error,
+};
+
+esp_err_t wav_player_pack_open(const char* filepath, wav_player_pack_handle_t* out_pack) {
+    if (filepath == NULL || out_pack == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    struct wav_player_pack *pack = calloc(1, sizeof(*pack));
+    if (pack == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    pack->fp = fopen(filepath, "rb");
+    if (pack->fp == NULL) {
+        ESP_LOGE(TAG, "Failed to open file %s", filepath);
+        free(pack);
+        return ESP_FAIL;
+    }
+
+    esp_err_t ret = ESP_FAIL;
+    uint8_t hdr[PACK_HEADER_SIZE];
+    if (fread(hdr, 1, sizeof(hdr), pack->fp) != sizeof(hdr) ||
+        memcmp(hdr, WAV_PLAYER_PACK_MAGIC, 4) != 0 ||
+        read_le16(&hdr[4]) != WAV_PLAYER_PACK_VERSION) {
+        ESP_LOGE(TAG, "Not an asset pack: %s", filepath);
+        goto fail;
+    }
+
+    pack->entry_count = read_le16(&hdr[6]);
+    uint32_t names_size = read_le32(&hdr[8]);
+    if (names_size > (uint32_t)pack->entry_count * PACK_MAX_NAME) {
+        ESP_LOGE(TAG, "Invalid name table size %lu", names_size);
+        goto fail;
+    }
+    pack->entries = calloc(pack->entry_count ? pack->entry_count : 1, sizeof(pack_entry_t));
+    pack->names = malloc(names_size ? names_size : 1);
+    if (pack->entries == NULL || pack->names == NULL) {
+        ret = ESP_ERR_NO_MEM;
+        goto fail;
+    }
+
+    for (uint16_t i = 0; i < pack->entry_count; i++) {
+        uint8_t raw[PACK_ENTRY_SIZE];
+        if (fread(raw, 1, sizeof(raw), pack->fp) != sizeof(raw)) {
+            ESP_LOGE(TAG, "Failed to read directory entry %d", i);
+            goto fail;
+        }
+
+        pack_entry_t *entry = &pack->entries[i];
+        entry->name_hash = read_le32(&raw[0]);
+        entry->data_offset = read_le32(&raw[4]);
+        entry->header.data_size = read_le32(&raw[8]);
+        entry->header.sample_rate = read_le32(&raw[12]);
+        entry->header.num_channels = read_le16(&raw[16]);
+        entry->header.bits_per_sample = read_le16(&raw[18]);
+        entry->header.block_align = read_le16(&raw[20]);
+        entry->name_offset = read_le32(&raw[24]);
+        if (entry->name_offset >= names_size) {
+            ESP_LOGE(TAG, "Name of entry %d outside the name table", i);
+            goto fail;
+        }
+
+        if (i > 0 && entry->name_hash <= pack->entries[i - 1].name_hash) {
+            ESP_LOGE(TAG, "Directory not sorted at entry %d", i);
+            goto fail;
+        }
+    }
+
+    // The table ends with a terminator, so every name offset yields a string
+    if (fread(pack->names, 1, names_size, pack->fp) != names_size ||
+        (names_size > 0 && pack->names[names_size - 1] != '\0')) {
+        ESP_LOGE(TAG, "Invalid name table");
+        goto fail;
+    }
+
+    pthread_mutex_init(&pack->lock, NULL);
+    pack->file_pos = ftell(pack->fp);
+
+    ESP_LOGI(TAG, "Opened pack %s with %d clips", filepath, pack->entry_count);
+    *out_pack = pack;
+    return ESP_OK;
+
+fail:
+    fclose(pack->fp);
+    free(pack->names);
+    free(pack->entries);
+    free(pack);
+    return ret;
+}
+
+void wav_player_pack_close(wav_player_pack_handle_t pack) {
+    if (pack == NULL) {
+        return;
+    }
+
+    pthread_mutex_destroy(&pack->lock);
+    fclose(pack->fp);
+    free(pack->names);
+    free(pack->entries);
+    free(pack);
+}
+
+esp_err_t wav_player_pack_get_info(wav_player_pack_handle_t pack, const char* name, wav_header_t* header) {
+    if (pack == NULL || name == NULL || header == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    const pack_entry_t *entry = pack_find(pack, name);
+    if (entry == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    *header = entry->header;
+    return ESP_OK;
+}
+
+esp_err_t wav_player_pack_play(wav_player_pack_handle_t pack, const char* name,
+                               wav_player_write_cb_t write_cb, void* user_data) {
+    if (pack == NULL || name == NULL || write_cb == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    const pack_entry_t *entry = pack_find(pack, name);
+    if (entry == NULL) {
+        ESP_LOGE(TAG, "Clip %s not found", name);
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (!is_valid_wav_header(&entry->header)) {
+        ESP_LOGE(TAG, "Invalid format for clip %s", name);
+        return ESP_FAIL;
+    }
+
+    pack_source_t ctx = {
+        .pack = pack,
+        .entry = entry,
+    };
+    wav_source_t source = {
+        .ops = &pack_source_ops,
+        .ctx = &ctx,
+    };
+    return wav_player_play_source(&source, &entry->header, write_cb, user_data);
+}
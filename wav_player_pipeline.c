@@ -0,0 +1,375 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "wav_player_pipeline.h"
+#include "wav_player_priv.h"
+#include "wav_player_trace_priv.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "wav_player_pipeline";
+
+#define PIPELINE_STAGE_STACK_SIZE 4096
+
+typedef struct {
+    uint8_t* data;
+    size_t bytes;               // 0 with underrun false marks the end of the data
+    bool underrun;
+    wav_player_underrun_policy_t policy;
+    uint32_t read_us;
+} raw_block_t;
+
+typedef struct {
+    int16_t* samples;
+    size_t bytes;               // 0 marks the end of playback
+    bool concealed;
+    uint32_t read_us;
+    uint32_t convert_us;
+} out_block_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;        // broadcast on every queue change
+    bool stop;
+
+    wav_source_t* source;
+    bool is_scheduled;
+    const wav_header_t* header;
+    size_t block_frames;
+    size_t depth;
+    wav_fx_chain_t fx;          // effect chain of this playback, run by the DSP stage
+
+    raw_block_t* raw;           // I/O stage -> DSP stage
+    uint32_t raw_head;          // blocks produced
+    uint32_t raw_tail;          // blocks consumed
+    out_block_t* out;           // DSP stage -> output stage
+    uint32_t out_head;
+    uint32_t out_tail;
+
+    wav_player_pipeline_stats_t stats;
+} pipeline_t;
+
+static pthread_mutex_t pipeline_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool pipeline_enabled;
+static wav_player_pipeline_config_t pipeline_config;
+static wav_player_pipeline_stats_t pipeline_stats;
+
+static void* io_stage(void* arg) {
+    pipeline_t *p = arg;
+    size_t read_size = p->block_frames * p->header->block_align;
+
+    for (;;) {
+        pthread_mutex_lock(&p->lock);
+        if (!p->stop && p->raw_head - p->raw_tail == p->depth) {
+            p->stats.read_blocked++;
+            while (!p->stop && p->raw_head - p->raw_tail == p->depth) {
+                pthread_cond_wait(&p->cond, &p->lock);
+            }
+        }
+        bool stop = p->stop;
+        raw_block_t *block = &p->raw[p->raw_head % p->depth];
+        pthread_mutex_unlock(&p->lock);
+        if (stop) {
+            break;
+        }
+
+        WAV_TRACE(WAV_TRACE_READ_BEGIN, 0);
+        int64_t start = esp_timer_get_time();
+        block->bytes = p->source->ops->read(p->source->ctx, block->data, read_size);
+        block->underrun = block->bytes == 0 && p->is_scheduled &&
+                          wav_sched_take_underrun(p->source, &block->policy);
+        block->read_us = esp_timer_get_time() - start;
+        WAV_TRACE(WAV_TRACE_READ_END, block->bytes);
+        p->stats.read_busy_us += block->read_us;
+
+        bool end = block->bytes == 0 && !block->underrun;
+        pthread_mutex_lock(&p->lock);
+        p->raw_head++;
+        pthread_cond_broadcast(&p->cond);
+        pthread_mutex_unlock(&p->lock);
+        if (end) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+static void* dsp_stage(void* arg) {
+    pipeline_t *p = arg;
+    const int16_t *last = NULL;
+    size_t last_frames = 0;
+    bool concealed = false;
+
+    for (;;) {
+        pthread_mutex_lock(&p->lock);
+        if (!p->stop && p->raw_head == p->raw_tail) {
+            p->stats.convert_starved++;
+        }
+        while (!p->stop && (p->raw_head == p->raw_tail || p->out_head - p->out_tail == p->depth)) {
+            pthread_cond_wait(&p->cond, &p->lock);
+        }
+        bool stop = p->stop;
+        raw_block_t *in = &p->raw[p->raw_tail % p->depth];
+        out_block_t *out = &p->out[p->out_head % p->depth];
+        pthread_mutex_unlock(&p->lock);
+        if (stop) {
+            break;
+        }
+
+        WAV_TRACE(WAV_TRACE_CONVERT_BEGIN, 0);
+        int64_t start = esp_timer_get_time();
+        bool end = false;
+        out->concealed = in->underrun;
+        out->read_us = in->read_us;
+        if (in->underrun) {
+            // Only the DSP stage writes output blocks, so the last one is intact
+            size_t frames = wav_conceal_block(out->samples, last, last_frames,
+                                              p->block_frames, concealed, in->policy);
+            out->bytes = frames * WAV_PLAYER_OUT_FRAME_BYTES;
+            concealed = true;
+            WAV_TRACE(WAV_TRACE_UNDERRUN, in->policy);
+        } else if (in->bytes == 0) {
+            out->bytes = 0;
+            end = true;
+        } else {
+            out->bytes = wav_convert_block(p->header, in->data, in->bytes, out->samples,
+                                           wav_player_get_volume());
+            end = out->bytes == 0;
+            last = out->samples;
+            last_frames = out->bytes / WAV_PLAYER_OUT_FRAME_BYTES;
+            wav_fx_process(&p->fx, out->samples, last_frames);
+            if (concealed) {
+                wav_fade_block(out->samples, last_frames, true);
+                concealed = false;
+            }
+        }
+        out->convert_us = esp_timer_get_time() - start;
+        WAV_TRACE(WAV_TRACE_CONVERT_END, out->bytes);
+        p->stats.convert_busy_us += out->convert_us;
+
+        pthread_mutex_lock(&p->lock);
+        p->raw_tail++;
+        p->out_head++;
+        pthread_cond_broadcast(&p->cond);
+        pthread_mutex_unlock(&p->lock);
+        if (end) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+static esp_err_t output_stage(pipeline_t* p, const wav_sink_t* sink) {
+    size_t batch = sink->writev_cb != NULL ? sink->max_blocks : 1;
+    wav_player_iovec_t iov[WAV_PLAYER_WRITEV_MAX_BLOCKS];
+    esp_err_t ret = ESP_OK;
+
+    for (;;) {
+        pthread_mutex_lock(&p->lock);
+        if (p->out_head == p->out_tail) {
+            p->stats.write_starved++;
+            while (p->out_head == p->out_tail) {
+                pthread_cond_wait(&p->cond, &p->lock);
+            }
+        }
+        size_t ready = p->out_head - p->out_tail;
+        pthread_mutex_unlock(&p->lock);
+
+        // Take every converted block up to the batch size instead of waiting for more
+        size_t count = 0;
+        size_t iovcnt = 0;
+        bool end = false;
+        while (count < ready && count < batch) {
+            out_block_t *block = &p->out[(p->out_tail + count) % p->depth];
+            if (block->bytes == 0) {
+                end = true;
+                break;
+            }
+            iovcnt = wav_iov_append(iov, iovcnt, block->samples, block->bytes);
+            count++;
+        }
+        if (count == 0) {
+            break;
+        }
+
+        WAV_TRACE(WAV_TRACE_WRITE_BEGIN, count);
+        int64_t start = esp_timer_get_time();
+        ret = wav_sink_write(sink, iov, iovcnt);
+        uint32_t write_us = esp_timer_get_time() - start;
+        WAV_TRACE(WAV_TRACE_WRITE_END, ret);
+        p->stats.write_busy_us += write_us;
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Write callback failed");
+            break;
+        }
+        for (size_t i = 0; i < count; i++) {
+            out_block_t *block = &p->out[(p->out_tail + i) % p->depth];
+            wav_playback_delivered(sink->playback, block->bytes / WAV_PLAYER_OUT_FRAME_BYTES,
+                                   block->concealed);
+            if (!block->concealed) {
+                size_t frames = block->bytes / WAV_PLAYER_OUT_FRAME_BYTES;
+                wav_stats_record_block(block->read_us, block->convert_us, write_us / count,
+                                       (uint64_t)frames * 1000000 / p->header->sample_rate);
+                p->stats.blocks++;
+            }
+        }
+
+        pthread_mutex_lock(&p->lock);
+        p->out_tail += count;
+        pthread_cond_broadcast(&p->cond);
+        pthread_mutex_unlock(&p->lock);
+        if (end) {
+            break;
+        }
+    }
+    return ret;
+}
+
+esp_err_t wav_pipeline_play(wav_source_t* source, bool is_scheduled, const wav_header_t* header,
+                            size_t block_frames, const wav_sink_t* sink) {
+    pthread_mutex_lock(&pipeline_lock);
+    bool enabled = pipeline_enabled;
+    wav_player_pipeline_config_t cfg = pipeline_config;
+    pthread_mutex_unlock(&pipeline_lock);
+    if (!enabled) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    size_t read_size = block_frames * header->block_align;
+    size_t out_size = block_frames * WAV_PLAYER_OUT_FRAME_BYTES;
+    pipeline_t *p = calloc(1, sizeof(*p));
+    uint8_t *mem = malloc(cfg.queue_depth * (read_size + out_size));
+    raw_block_t *raw = calloc(cfg.queue_depth, sizeof(raw_block_t));
+    out_block_t *out = calloc(cfg.queue_depth, sizeof(out_block_t));
+    if (p == NULL || mem == NULL || raw == NULL || out == NULL || wav_fx_chain_create(&p->fx) != ESP_OK) {
+        ESP_LOGW(TAG, "No memory for pipeline, playing serially");
+        free(p);
+        free(mem);
+        free(raw);
+        free(out);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    // Output blocks first, keeping the int16_t samples aligned
+    for (size_t i = 0; i < cfg.queue_depth; i++) {
+        out[i].samples = (int16_t*)(mem + i * out_size);
+        raw[i].data = mem + cfg.queue_depth * out_size + i * read_size;
+    }
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->cond, NULL);
+    p->source = source;
+    p->is_scheduled = is_scheduled;
+    p->header = header;
+    p->block_frames = block_frames;
+    p->depth = cfg.queue_depth;
+    p->raw = raw;
+    p->out = out;
+
+    if (wav_player_num_cores() < 2) {
+        cfg.io_core = WAV_PLAYER_CORE_ANY;
+        cfg.dsp_core = WAV_PLAYER_CORE_ANY;
+    }
+
+    // Start the DSP stage first, it only waits, so a failure leaves the source unread
+    pthread_t dsp_thread;
+    pthread_t io_thread;
+    esp_err_t ret = wav_player_thread_create(&dsp_thread, dsp_stage, p, "wav_dsp",
+                                             cfg.dsp_core, PIPELINE_STAGE_STACK_SIZE);
+    if (ret == ESP_OK) {
+        ret = wav_player_thread_create(&io_thread, io_stage, p, "wav_io",
+                                       cfg.io_core, PIPELINE_STAGE_STACK_SIZE);
+        if (ret != ESP_OK) {
+            pthread_mutex_lock(&p->lock);
+            p->stop = true;
+            pthread_cond_broadcast(&p->cond);
+            pthread_mutex_unlock(&p->lock);
+            pthread_join(dsp_thread, NULL);
+        }
+    }
+
+    if (ret == ESP_OK) {
+        int64_t start = esp_timer_get_time();
+        ret = output_stage(p, sink);
+
+        pthread_mutex_lock(&p->lock);
+        p->stop = true;
+        pthread_cond_broadcast(&p->cond);
+        pthread_mutex_unlock(&p->lock);
+        pthread_join(io_thread, NULL);
+        pthread_join(dsp_thread, NULL);
+        p->stats.elapsed_us = esp_timer_get_time() - start;
+        if (ret == ESP_OK) {
+            ret = wav_source_error(source);
+        }
+
+        pthread_mutex_lock(&pipeline_lock);
+        pipeline_stats.elapsed_us += p->stats.elapsed_us;
+        pipeline_stats.read_busy_us += p->stats.read_busy_us;
+        pipeline_stats.convert_busy_us += p->stats.convert_busy_us;
+        pipeline_stats.write_busy_us += p->stats.write_busy_us;
+        pipeline_stats.blocks += p->stats.blocks;
+        pipeline_stats.read_blocked += p->stats.read_blocked;
+        pipeline_stats.convert_starved += p->stats.convert_starved;
+        pipeline_stats.write_starved += p->stats.write_starved;
+        pthread_mutex_unlock(&pipeline_lock);
+    } else {
+        ESP_LOGW(TAG, "Failed to start pipeline stages, playing serially");
+        ret = ESP_ERR_NOT_SUPPORTED;
+    }
+
+    pthread_cond_destroy(&p->cond);
+    pthread_mutex_destroy(&p->lock);
+    wav_fx_chain_free(&p->fx);
+    free(out);
+    free(raw);
+    free(mem);
+    free(p);
+    return ret;
+}
+
+esp_err_t wav_player_pipeline_init(const wav_player_pipeline_config_t* config) {
+    wav_player_pipeline_config_t cfg = WAV_PLAYER_PIPELINE_CONFIG_DEFAULT();
+    if (config != NULL) {
+        cfg = *config;
+    }
+    if (cfg.queue_depth == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&pipeline_lock);
+    if (pipeline_enabled) {
+        pthread_mutex_unlock(&pipeline_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    pipeline_config = cfg;
+    pipeline_enabled = true;
+    pthread_mutex_unlock(&pipeline_lock);
+
+    ESP_LOGI(TAG, "Pipelined playback enabled: I/O core %d, DSP core %d, %u blocks per queue",
+             cfg.io_core, cfg.dsp_core, (unsigned)cfg.queue_depth);
+    return ESP_OK;
+}
+
+esp_err_t wav_player_pipeline_get_stats(wav_player_pipeline_stats_t* stats) {
+    if (stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&pipeline_lock);
+    *stats = pipeline_stats;
+    pthread_mutex_unlock(&pipeline_lock);
+    return ESP_OK;
+}
+
+void wav_player_pipeline_reset_stats(void) {
+    pthread_mutex_lock(&pipeline_lock);
+    memset(&pipeline_stats, 0, sizeof(pipeline_stats));
+    pthread_mutex_unlock(&pipeline_lock);
+}
+
+void wav_player_pipeline_deinit(void) {
+    pthread_mutex_lock(&pipeline_lock);
+    pipeline_enabled = false;
+    pthread_mutex_unlock(&pipeline_lock);
+}
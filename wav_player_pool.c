@@ -0,0 +1,229 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "wav_player_pool.h"
+#include "wav_player_priv.h"
+#include "esp_log.h"
+
+static const char *TAG = "wav_player_pool";
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static wav_pool_entry_t* pool_entries;
+static size_t pool_size;
+static uint32_t pool_tick;
+
+static void entry_close(wav_pool_entry_t* entry) {
+    if (entry->fp != NULL) {
+        fclose(entry->fp);
+    }
+    free(entry->path);
+    wav_file_meta_free(&entry->meta);
+    entry->fp = NULL;
+    entry->path = NULL;
+}
+
+/**
+ * @brief Pick the slot for a new file, called with pool_lock held
+ *
+ * @return Free slot, least recently used idle slot, or NULL if all are in use
+ */
+static wav_pool_entry_t* pool_pick_slot(void) {
+    wav_pool_entry_t *victim = NULL;
+
+    for (size_t i = 0; i < pool_size; i++) {
+        wav_pool_entry_t *entry = &pool_entries[i];
+        if (entry->fp == NULL) {
+            return entry;
+        }
+        if (!entry->in_use && (victim == NULL || (int32_t)(entry->last_used - victim->last_used) < 0)) {
+            victim = entry;
+        }
+    }
+    return victim;
+}
+
+/**
+ * @brief Take an idle pooled entry of a file, rewound to the start of the PCM data
+ *
+ * @return The entry, or NULL on a miss or a disabled pool
+ */
+static wav_pool_entry_t* pool_take(const char* filepath, uint32_t hash) {
+    pthread_mutex_lock(&pool_lock);
+    wav_pool_entry_t *hit = NULL;
+    for (size_t i = 0; i < pool_size; i++) {
+        wav_pool_entry_t *entry = &pool_entries[i];
+        if (entry->fp != NULL && !entry->in_use && entry->path_hash == hash &&
+            strcmp(entry->path, filepath) == 0) {
+            hit = entry;
+            hit->in_use = true;
+            hit->last_used = ++pool_tick;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&pool_lock);
+
+    if (hit != NULL && fseek(hit->fp, hit->info.data_offset, SEEK_SET) != 0) {
+        ESP_LOGW(TAG, "Failed to rewind pooled %s", filepath);
+        wav_pool_release(hit, false);
+        hit = NULL;
+    }
+    return hit;
+}
+
+wav_pool_entry_t* wav_pool_acquire_cached(const char* filepath) {
+    return pool_take(filepath, wav_player_hash_name(filepath));
+}
+
+esp_err_t wav_pool_acquire(const char* filepath, wav_pool_entry_t** out_entry) {
+    *out_entry = NULL;
+    uint32_t hash = wav_player_hash_name(filepath);
+
+    pthread_mutex_lock(&pool_lock);
+    bool enabled = pool_entries != NULL;
+    pthread_mutex_unlock(&pool_lock);
+    if (!enabled) {
+        return ESP_OK;
+    }
+    *out_entry = pool_take(filepath, hash);
+    if (*out_entry != NULL) {
+        return ESP_OK;
+    }
+
+    // Miss: open and parse without holding the lock
+    wav_pool_entry_t opened = {
+        .path_hash = hash,
+        .in_use = true,
+    };
+    opened.fp = fopen(filepath, "rb");
+    if (opened.fp == NULL) {
+        ESP_LOGE(TAG, "Failed to open file %s", filepath);
+        return ESP_FAIL;
+    }
+    // The entry outlives this playback, so parse the metadata later ones may need too
+    esp_err_t ret = read_wav_info(opened.fp, &opened.info, false, &opened.meta);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Invalid WAV header in %s", filepath);
+        wav_file_meta_free(&opened.meta);
+        fclose(opened.fp);
+        return ret;
+    }
+    opened.path = strdup(filepath);
+
+    FILE *evicted = NULL;
+    char *evicted_path = NULL;
+    wav_file_meta_t evicted_meta = {0};
+    wav_pool_entry_t *slot = NULL;
+
+    pthread_mutex_lock(&pool_lock);
+    if (pool_entries != NULL && opened.path != NULL) {
+        slot = pool_pick_slot();
+    }
+    if (slot != NULL) {
+        evicted = slot->fp;
+        evicted_path = slot->path;
+        evicted_meta = slot->meta;
+        opened.pooled = true;
+        opened.last_used = ++pool_tick;
+        *slot = opened;
+    }
+    pthread_mutex_unlock(&pool_lock);
+
+    if (evicted != NULL) {
+        ESP_LOGD(TAG, "Closing %s", evicted_path);
+        fclose(evicted);
+    }
+    free(evicted_path);
+    wav_file_meta_free(&evicted_meta);
+
+    if (slot == NULL) {
+        // All handles are busy, lend a temporary entry closed on release
+        slot = malloc(sizeof(*slot));
+        if (slot == NULL) {
+            entry_close(&opened);
+            return ESP_ERR_NO_MEM;
+        }
+        *slot = opened;
+    }
+
+    *out_entry = slot;
+    return ESP_OK;
+}
+
+void wav_pool_release(wav_pool_entry_t* entry, bool keep) {
+    if (!entry->pooled) {
+        entry_close(entry);
+        free(entry);
+        return;
+    }
+
+    FILE *fp = NULL;
+    char *path = NULL;
+    wav_file_meta_t meta = {0};
+
+    pthread_mutex_lock(&pool_lock);
+    if (!keep) {
+        fp = entry->fp;
+        path = entry->path;
+        meta = entry->meta;
+        entry->fp = NULL;
+        entry->path = NULL;
+        memset(&entry->meta, 0, sizeof(entry->meta));
+    }
+    entry->in_use = false;
+    pthread_mutex_unlock(&pool_lock);
+
+    if (fp != NULL) {
+        fclose(fp);
+    }
+    free(path);
+    wav_file_meta_free(&meta);
+}
+
+esp_err_t wav_player_pool_init(size_t max_handles) {
+    if (max_handles == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    wav_pool_entry_t *entries = calloc(max_handles, sizeof(wav_pool_entry_t));
+    if (entries == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    pthread_mutex_lock(&pool_lock);
+    if (pool_entries != NULL) {
+        pthread_mutex_unlock(&pool_lock);
+        free(entries);
+        return ESP_ERR_INVALID_STATE;
+    }
+    pool_entries = entries;
+    pool_size = max_handles;
+    pthread_mutex_unlock(&pool_lock);
+
+    ESP_LOGI(TAG, "File handle pool enabled with %u handles", (unsigned)max_handles);
+    return ESP_OK;
+}
+
+void wav_player_pool_flush(void) {
+    pthread_mutex_lock(&pool_lock);
+    for (size_t i = 0; i < pool_size; i++) {
+        if (!pool_entries[i].in_use) {
+            entry_close(&pool_entries[i]);
+        }
+    }
+    pthread_mutex_unlock(&pool_lock);
+}
+
+void wav_player_pool_deinit(void) {
+    pthread_mutex_lock(&pool_lock);
+    wav_pool_entry_t *entries = pool_entries;
+    size_t size = pool_size;
+    pool_entries = NULL;
+    pool_size = 0;
+    pthread_mutex_unlock(&pool_lock);
+
+    for (size_t i = 0; i < size; i++) {
+        entry_close(&entries[i]);
+    }
+    free(entries);
+}
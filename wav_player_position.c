@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <stdatomic.h>
+#include "wav_player_position.h"
+#include "wav_player_priv.h"
+
+// Position of the most recently started playback, written only by its task
+static wav_position_clock_t current_clock;
+static atomic_uint current_id;
+static atomic_flag current_writer = ATOMIC_FLAG_INIT;
+
+void wav_position_clock_write(wav_position_clock_t* clock, uint64_t delivered, uint32_t sample_rate) {
+    // Fill the slot readers are not using, then switch them over
+    unsigned seq = atomic_load_explicit(&clock->seq, memory_order_relaxed);
+    wav_position_slot_t *slot = &clock->slots[(seq + 1) & 1];
+    // A slow reader may still check this slot against the last seq, which must reach it first
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&slot->delivered_lo, (uint32_t)delivered, memory_order_relaxed);
+    atomic_store_explicit(&slot->delivered_hi, (uint32_t)(delivered >> 32), memory_order_relaxed);
+    atomic_store_explicit(&slot->sample_rate, sample_rate, memory_order_relaxed);
+    atomic_store_explicit(&clock->seq, seq + 1, memory_order_release);
+}
+
+static void clock_read(wav_position_clock_t* clock, wav_player_position_t* pos) {
+    unsigned seq;
+    uint64_t delivered;
+    uint32_t sample_rate;
+
+    // The slot read is only rewritten after the sequence moved on, so a reader
+    // that preempts the writer never waits for it
+    do {
+        seq = atomic_load_explicit(&clock->seq, memory_order_acquire);
+        wav_position_slot_t *slot = &clock->slots[seq & 1];
+        delivered = atomic_load_explicit(&slot->delivered_lo, memory_order_relaxed) |
+                    (uint64_t)atomic_load_explicit(&slot->delivered_hi, memory_order_relaxed) << 32;
+        sample_rate = atomic_load_explicit(&slot->sample_rate, memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+    } while (seq != atomic_load_explicit(&clock->seq, memory_order_relaxed));
+
+    uint32_t latency = atomic_load_explicit(&clock->latency, memory_order_relaxed);
+    pos->delivered_frames = delivered;
+    pos->played_frames = delivered > latency ? delivered - latency : 0;
+    pos->delivered_ms = wav_player_frames_to_ms(pos->delivered_frames, sample_rate);
+    pos->played_ms = wav_player_frames_to_ms(pos->played_frames, sample_rate);
+    pos->sample_rate = sample_rate;
+}
+
+uint32_t wav_position_claim(void) {
+    return atomic_fetch_add(&current_id, 1) + 1;
+}
+
+void wav_position_publish(uint32_t id, uint64_t delivered, uint32_t sample_rate) {
+    if (atomic_load(&current_id) != id) {
+        return;
+    }
+    // A newer playback may be starting on another task, its next update wins
+    if (atomic_flag_test_and_set_explicit(&current_writer, memory_order_acquire)) {
+        return;
+    }
+    if (atomic_load(&current_id) == id) {
+        wav_position_clock_write(&current_clock, delivered, sample_rate);
+    }
+    atomic_flag_clear_explicit(&current_writer, memory_order_release);
+}
+
+esp_err_t wav_player_get_position(wav_player_position_t* pos) {
+    if (pos == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (atomic_load(&current_id) == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    clock_read(&current_clock, pos);
+    return ESP_OK;
+}
+
+esp_err_t wav_position_clock_get(wav_position_clock_t* clock, wav_player_position_t* pos) {
+    if (pos == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    clock_read(clock, pos);
+    return ESP_OK;
+}
+
+void wav_player_set_sink_latency(uint32_t frames) {
+    atomic_store_explicit(&current_clock.latency, frames, memory_order_relaxed);
+}
+
+uint64_t wav_player_frames_to_ms(uint64_t frames, uint32_t sample_rate) {
+    return sample_rate > 0 ? frames * 1000 / sample_rate : 0;
+}
@@ -0,0 +1,475 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "wav_player_prefetch.h"
+#include "wav_player_priv.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+static const char *TAG = "wav_player_prefetch";
+
+#define PREFETCH_WORKER_STACK_SIZE 4096
+
+typedef struct prefetch_entry {
+    struct prefetch_entry* next;
+    char* path;
+    uint32_t path_hash;
+    wav_player_info_t info;
+    wav_file_meta_t meta;
+    uint8_t* head;              // first head_len bytes of the PCM data
+    uint32_t head_len;
+    uint32_t refs;              // sources currently playing this entry
+    uint32_t last_used;         // LRU stamp
+} prefetch_entry_t;
+
+typedef struct prefetch_request {
+    struct prefetch_request* next;
+    uint32_t head_ms;
+    char path[];
+} prefetch_request_t;
+
+typedef struct {
+    prefetch_entry_t* entry;
+    uint32_t pos;               // read position within the PCM data
+    FILE* fp;                   // positioned past the head, NULL if the head is the whole file
+    wav_pool_entry_t* pooled;   // set if fp is borrowed from the handle pool
+    bool disk_failed;           // storage could not be opened, positioned or read
+} prefetch_source_t;
+
+static pthread_mutex_t prefetch_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t prefetch_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t prefetch_worker;
+static bool prefetch_running;
+static size_t prefetch_budget;
+static size_t prefetch_used;
+static uint32_t prefetch_tick;
+static prefetch_entry_t* prefetch_entries;
+static prefetch_request_t* queue_head;
+static prefetch_request_t* queue_tail;
+
+static void entry_free(prefetch_entry_t* entry) {
+    wav_file_meta_free(&entry->meta);
+    free(entry->head);
+    free(entry->path);
+    free(entry);
+}
+
+/**
+ * @brief Find a cached file, called with prefetch_lock held
+ */
+static prefetch_entry_t* cache_find(const char* filepath, uint32_t hash) {
+    for (prefetch_entry_t *entry = prefetch_entries; entry != NULL; entry = entry->next) {
+        if (entry->path_hash == hash && strcmp(entry->path, filepath) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Drop least recently used idle entries until size more bytes fit,
+ *        called with prefetch_lock held
+ *
+ * @return true if size bytes fit into the budget
+ */
+static bool cache_make_room(size_t size) {
+    while (prefetch_used + size > prefetch_budget) {
+        prefetch_entry_t **victim = NULL;
+        for (prefetch_entry_t **link = &prefetch_entries; *link != NULL; link = &(*link)->next) {
+            if ((*link)->refs == 0 &&
+                (victim == NULL || (int32_t)((*link)->last_used - (*victim)->last_used) < 0)) {
+                victim = link;
+            }
+        }
+        if (victim == NULL) {
+            return false;
+        }
+
+        prefetch_entry_t *entry = *victim;
+        *victim = entry->next;
+        prefetch_used -= entry->head_len;
+        entry_free(entry);
+    }
+    return true;
+}
+
+/**
+ * @brief Open, parse and read the head of one file into the cache
+ */
+static void prefetch_file(const char* filepath, uint32_t head_ms) {
+    uint32_t hash = wav_player_hash_name(filepath);
+
+    pthread_mutex_lock(&prefetch_lock);
+    prefetch_entry_t *cached = cache_find(filepath, hash);
+    if (cached != NULL) {
+        cached->last_used = ++prefetch_tick;
+    }
+    pthread_mutex_unlock(&prefetch_lock);
+    if (cached != NULL) {
+        return;
+    }
+
+    prefetch_entry_t *entry = calloc(1, sizeof(*entry));
+    if (entry == NULL) {
+        return;
+    }
+    entry->path = strdup(filepath);
+    entry->path_hash = hash;
+
+    // Warm the handle pool too when it is enabled, so playback continues without fopen
+    wav_pool_entry_t *pooled = NULL;
+    FILE *fp = NULL;
+    if (entry->path == NULL || wav_pool_acquire(filepath, &pooled) != ESP_OK) {
+        entry_free(entry);
+        return;
+    }
+    if (pooled != NULL) {
+        fp = pooled->fp;
+        entry->info = pooled->info;
+        // The pooled entry can be evicted while this one stays cached
+        if (wav_file_meta_copy(&entry->meta, &pooled->meta) != ESP_OK) {
+            wav_pool_release(pooled, true);
+            entry_free(entry);
+            return;
+        }
+    } else {
+        fp = fopen(filepath, "rb");
+        if (fp == NULL || read_wav_info(fp, &entry->info, false, &entry->meta) != ESP_OK) {
+            ESP_LOGW(TAG, "Cannot prefetch %s", filepath);
+            if (fp != NULL) {
+                fclose(fp);
+            }
+            entry_free(entry);
+            return;
+        }
+    }
+
+    const wav_header_t *header = &entry->info.header;
+    uint64_t head_frames = (uint64_t)header->sample_rate * head_ms / 1000;
+    uint64_t head_len = head_frames * header->block_align;
+    if (head_len > header->data_size) {
+        head_len = header->data_size - header->data_size % header->block_align;
+    }
+
+    entry->head = heap_caps_malloc_prefer(head_len ? head_len : 1, 2,
+                                          MALLOC_CAP_SPIRAM, MALLOC_CAP_DEFAULT);
+    if (entry->head != NULL) {
+        entry->head_len = fread(entry->head, 1, head_len, fp);
+    }
+
+    if (pooled != NULL) {
+        wav_pool_release(pooled, true);
+    } else {
+        fclose(fp);
+    }
+
+    if (entry->head == NULL || entry->head_len != head_len) {
+        ESP_LOGW(TAG, "Failed to read head of %s", filepath);
+        entry_free(entry);
+        return;
+    }
+
+    pthread_mutex_lock(&prefetch_lock);
+    bool stored = prefetch_running && cache_find(filepath, hash) == NULL && cache_make_room(head_len);
+    if (stored) {
+        entry->last_used = ++prefetch_tick;
+        entry->next = prefetch_entries;
+        prefetch_entries = entry;
+        prefetch_used += head_len;
+    }
+    pthread_mutex_unlock(&prefetch_lock);
+
+    if (stored) {
+        ESP_LOGD(TAG, "Prefetched %lu bytes of %s", entry->head_len, filepath);
+    } else {
+        entry_free(entry);
+    }
+}
+
+static void* prefetch_task(void* arg) {
+    for (;;) {
+        pthread_mutex_lock(&prefetch_lock);
+        while (prefetch_running && queue_head == NULL) {
+            pthread_cond_wait(&prefetch_cond, &prefetch_lock);
+        }
+        if (!prefetch_running) {
+            pthread_mutex_unlock(&prefetch_lock);
+            break;
+        }
+        prefetch_request_t *request = queue_head;
+        queue_head = request->next;
+        if (queue_head == NULL) {
+            queue_tail = NULL;
+        }
+        pthread_mutex_unlock(&prefetch_lock);
+
+        prefetch_file(request->path, request->head_ms);
+        free(request);
+    }
+    return NULL;
+}
+
+static size_t prefetch_source_read(void* ctx, void* dst, size_t size) {
+    prefetch_source_t *src = ctx;
+    prefetch_entry_t *entry = src->entry;
+
+    size_t remaining = entry->info.header.data_size - src->pos;
+    if (size > remaining) {
+        size = remaining;
+    }
+    if (size == 0) {
+        return 0;
+    }
+
+    if (src->pos < entry->head_len) {
+        size_t n = entry->head_len - src->pos;
+        if (n > size) {
+            n = size;
+        }
+        memcpy(dst, entry->head + src->pos, n);
+        src->pos += n;
+        return n;
+    }
+
+    if (src->disk_failed) {
+        return 0;
+    }
+
+    size_t bytes_read = fread(dst, 1, size, src->fp);
+    src->pos += bytes_read;
+    if (bytes_read < size) {
+        src->disk_failed = true;
+    }
+    return bytes_read;
+}
+
+static esp_err_t prefetch_source_seek(void* ctx, uint32_t offset) {
+    prefetch_source_t *src = ctx;
+    prefetch_entry_t *entry = src->entry;
+
+    if (offset > entry->info.header.data_size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    src->pos = offset;
+
+    // Storage continues where the head ends
+    uint32_t disk_pos = offset > entry->head_len ? offset : entry->head_len;
+    if (src->fp != NULL && fseek(src->fp, (long)entry->info.data_offset + disk_pos, SEEK_SET) != 0) {
+        src->disk_failed = true;
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t prefetch_source_error(void* ctx) {
+    prefetch_source_t *src = ctx;
+    return src->disk_failed ? ESP_FAIL : ESP_OK;
+}
+
+static void prefetch_source_close(void* ctx) {
+    prefetch_source_t *src = ctx;
+
+    if (src->pooled != NULL) {
+        wav_pool_release(src->pooled, !src->disk_failed);
+    } else if (src->fp != NULL) {
+        fclose(src->fp);
+    }
+
+    pthread_mutex_lock(&prefetch_lock);
+    src->entry->refs--;
+    pthread_mutex_unlock(&prefetch_lock);
+
+    free(src);
+}
+
+/**
+ * @brief Open the file behind a cached head and position it past the head
+ *
+ * The header is known already, so a pool miss opens the file without parsing it.
+ */
+static esp_err_t prefetch_source_open_disk(prefetch_source_t* src) {
+    prefetch_entry_t *entry = src->entry;
+
+    src->pooled = wav_pool_acquire_cached(entry->path);
+    src->fp = src->pooled != NULL ? src->pooled->fp : fopen(entry->path, "rb");
+    if (src->fp == NULL ||
+        fseek(src->fp, (long)entry->info.data_offset + entry->head_len, SEEK_SET) != 0) {
+        ESP_LOGE(TAG, "Failed to continue %s from storage", entry->path);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static const wav_source_ops_t prefetch_source_ops = {
+    .read = prefetch_source_read,
+    .seek = prefetch_source_seek,
+    .close = prefetch_source_close,
+    .error = prefetch_source_error,
+};
+
+esp_err_t wav_prefetch_open(const char* filepath, wav_source_t* source, wav_player_info_t* info,
+                            const wav_file_meta_t** meta) {
+    uint32_t hash = wav_player_hash_name(filepath);
+
+    pthread_mutex_lock(&prefetch_lock);
+    prefetch_entry_t *entry = prefetch_running ? cache_find(filepath, hash) : NULL;
+    if (entry != NULL) {
+        entry->refs++;
+        entry->last_used = ++prefetch_tick;
+    }
+    pthread_mutex_unlock(&prefetch_lock);
+
+    if (entry == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    prefetch_source_t *src = calloc(1, sizeof(*src));
+    if (src == NULL) {
+        pthread_mutex_lock(&prefetch_lock);
+        entry->refs--;
+        pthread_mutex_unlock(&prefetch_lock);
+        return ESP_ERR_NO_MEM;
+    }
+    src->entry = entry;
+
+    // Open the rest now, so the read crossing the end of the head never waits for storage
+    if (entry->head_len < entry->info.header.data_size && prefetch_source_open_disk(src) != ESP_OK) {
+        src->disk_failed = true;
+        prefetch_source_close(src);
+        return ESP_FAIL;
+    }
+
+    source->ops = &prefetch_source_ops;
+    source->ctx = src;
+    source->block_size = 0;
+    *info = entry->info;
+    *meta = &entry->meta;
+    return ESP_OK;
+}
+
+esp_err_t wav_player_prefetch_init(size_t cache_bytes) {
+    if (cache_bytes == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&prefetch_lock);
+    if (prefetch_running) {
+        pthread_mutex_unlock(&prefetch_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    prefetch_budget = cache_bytes;
+    prefetch_running = true;
+    pthread_mutex_unlock(&prefetch_lock);
+
+    esp_err_t ret = wav_player_thread_create(&prefetch_worker, prefetch_task, NULL, "wav_prefetch",
+                                             WAV_PLAYER_CORE_ANY, PREFETCH_WORKER_STACK_SIZE);
+    if (ret != ESP_OK) {
+        pthread_mutex_lock(&prefetch_lock);
+        prefetch_running = false;
+        pthread_mutex_unlock(&prefetch_lock);
+        return ret;
+    }
+
+    ESP_LOGI(TAG, "Prefetch enabled with %u bytes of cache", (unsigned)cache_bytes);
+    return ESP_OK;
+}
+
+esp_err_t wav_player_prefetch(const char* const* paths, size_t count, uint32_t head_ms) {
+    if ((paths == NULL && count > 0) || head_ms == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Build the requests before taking the lock so the worker is never blocked on malloc
+    prefetch_request_t *first = NULL;
+    prefetch_request_t *last = NULL;
+    for (size_t i = 0; i < count; i++) {
+        size_t len = strlen(paths[i]) + 1;
+        prefetch_request_t *request = malloc(sizeof(*request) + len);
+        if (request == NULL) {
+            while (first != NULL) {
+                prefetch_request_t *next = first->next;
+                free(first);
+                first = next;
+            }
+            return ESP_ERR_NO_MEM;
+        }
+        request->next = NULL;
+        request->head_ms = head_ms;
+        memcpy(request->path, paths[i], len);
+        if (last != NULL) {
+            last->next = request;
+        } else {
+            first = request;
+        }
+        last = request;
+    }
+    if (first == NULL) {
+        return ESP_OK;
+    }
+
+    pthread_mutex_lock(&prefetch_lock);
+    if (!prefetch_running) {
+        pthread_mutex_unlock(&prefetch_lock);
+        while (first != NULL) {
+            prefetch_request_t *next = first->next;
+            free(first);
+            first = next;
+        }
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (queue_tail != NULL) {
+        queue_tail->next = first;
+    } else {
+        queue_head = first;
+    }
+    queue_tail = last;
+    pthread_cond_signal(&prefetch_cond);
+    pthread_mutex_unlock(&prefetch_lock);
+
+    return ESP_OK;
+}
+
+void wav_player_prefetch_clear(void) {
+    pthread_mutex_lock(&prefetch_lock);
+    prefetch_entry_t **link = &prefetch_entries;
+    while (*link != NULL) {
+        prefetch_entry_t *entry = *link;
+        if (entry->refs == 0) {
+            *link = entry->next;
+            prefetch_used -= entry->head_len;
+            entry_free(entry);
+        } else {
+            link = &entry->next;
+        }
+    }
+    pthread_mutex_unlock(&prefetch_lock);
+}
+
+void wav_player_prefetch_deinit(void) {
+    pthread_mutex_lock(&prefetch_lock);
+    if (!prefetch_running) {
+        pthread_mutex_unlock(&prefetch_lock);
+        return;
+    }
+    prefetch_running = false;
+    pthread_cond_signal(&prefetch_cond);
+    pthread_mutex_unlock(&prefetch_lock);
+
+    pthread_join(prefetch_worker, NULL);
+
+    pthread_mutex_lock(&prefetch_lock);
+    while (queue_head != NULL) {
+        prefetch_request_t *next = queue_head->next;
+        free(queue_head);
+        queue_head = next;
+    }
+    queue_tail = NULL;
+    while (prefetch_entries != NULL) {
+        prefetch_entry_t *next = prefetch_entries->next;
+        entry_free(prefetch_entries);
+        prefetch_entries = next;
+    }
+    prefetch_used = 0;
+    pthread_mutex_unlock(&prefetch_lock);
+}
@@ -0,0 +1,553 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "wav_player_sched.h"
+#include "wav_player_priv.h"
+#include "wav_player_trace_priv.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "wav_player_sched";
+
+#define SCHED_TASK_STACK_SIZE 4096
+#define SCHED_ADAPT_WINDOW 32       // reads between latency decays and resizes
+#define SCHED_LATENCY_MARGIN 2
+
+typedef struct sched_stream {
+    struct sched_stream* next;
+    wav_source_t* inner;
+    uint16_t block_align;
+    uint32_t byte_rate;         // consumption rate in bytes per second
+    uint8_t* buf;               // read-ahead ring buffer
+    size_t cap;
+    size_t rd;                  // consumer position
+    size_t wr;                  // producer position
+    size_t fill;                // bytes buffered
+    bool eof;                   // inner source is exhausted
+    esp_err_t error;            // why the inner source ended, set with eof
+    bool io_busy;               // I/O task is reading into the buffer
+    bool refilling;             // burst mode: filling until the buffer is full
+    bool underrun;              // last read timed out waiting for data
+    pthread_cond_t cond;        // signalled when data arrives or a read completes
+} sched_stream_t;
+
+static pthread_mutex_t sched_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sched_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t sched_task;
+static bool sched_running;
+static wav_player_sched_config_t sched_config;
+static sched_stream_t* sched_streams;
+static wav_player_sched_stats_t sched_stats;
+static int64_t sched_start_us;
+static uint32_t sched_latency_hist[WAV_PLAYER_LATENCY_BUCKETS];
+static uint32_t sched_window_reads;
+static uint64_t sched_need_us;      // buffered audio needed to ride out slow reads
+static int64_t sched_underrun_log[WAV_PLAYER_SCHED_UNDERRUN_LOG];
+
+static uint8_t* stream_alloc(size_t size) {
+    // Burst buffers hold seconds of audio, keep them out of internal RAM when possible
+    if (sched_config.burst) {
+        return heap_caps_malloc_prefer(size, 2, MALLOC_CAP_SPIRAM, MALLOC_CAP_DEFAULT);
+    }
+    return malloc(size);
+}
+
+static uint64_t stream_buffered_us(const sched_stream_t* stream) {
+    return (uint64_t)stream->fill * 1000000 / stream->byte_rate;
+}
+
+/**
+ * @brief Whether the I/O task has work for a stream, called with sched_lock held
+ */
+static bool stream_wants_data(const sched_stream_t* stream) {
+    if (stream->eof) {
+        return false;
+    }
+    if (sched_config.burst) {
+        uint64_t watermark_us = (uint64_t)sched_config.low_watermark_ms * 1000;
+        if (sched_config.adaptive && sched_need_us > watermark_us) {
+            watermark_us = sched_need_us;
+        }
+        // A drained stream always refills, even with a watermark of 0
+        return stream->refilling || stream->fill < stream->block_align ||
+               stream_buffered_us(stream) < watermark_us;
+    }
+    return stream->cap - stream->fill >= sched_config.min_read_size;
+}
+
+/**
+ * @brief Bytes the next read of a stream should fetch
+ *
+ * Covers read_period_ms of consumption, or max_read_size in burst mode,
+ * bounded by the configured read sizes and by the free contiguous space of
+ * the ring.
+ */
+static size_t stream_read_size(const sched_stream_t* stream) {
+    size_t want = sched_config.burst ? sched_config.max_read_size :
+                  (size_t)((uint64_t)stream->byte_rate * sched_config.read_period_ms / 1000);
+    if (want < sched_config.min_read_size) {
+        want = sched_config.min_read_size;
+    }
+    if (want > sched_config.max_read_size) {
+        want = sched_config.max_read_size;
+    }
+
+    size_t free_space = stream->cap - stream->fill;
+    if (want > free_space) {
+        want = free_space;
+    }
+    size_t contiguous = stream->cap - stream->wr;
+    return want < contiguous ? want : contiguous;
+}
+
+/**
+ * @brief Choose the stream to read for next, called with sched_lock held
+ *
+ * Picks the stream with the least buffered playback time among those with
+ * room for a worthwhile read. A stream whose contiguous space is cut short by
+ * the ring wrap is still served so it can wrap around, and a burst refill
+ * continues until the buffer is full.
+ */
+static sched_stream_t* sched_pick_stream(size_t* read_size) {
+    sched_stream_t *best = NULL;
+    uint64_t best_time = UINT64_MAX;
+
+    for (sched_stream_t *stream = sched_streams; stream != NULL; stream = stream->next) {
+        if (!stream_wants_data(stream)) {
+            continue;
+        }
+        size_t size = stream_read_size(stream);
+        bool wraps = size == stream->cap - stream->wr;
+        if (size == 0 || (size < sched_config.min_read_size && !wraps && !stream->refilling)) {
+            continue;
+        }
+
+        // Buffered time in microseconds, lower means closer to underrun
+        uint64_t buffered_us = stream_buffered_us(stream);
+        if (buffered_us < best_time) {
+            best = stream;
+            best_time = buffered_us;
+            *read_size = size;
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief Read-ahead capacity for a consumption rate, called with sched_lock held
+ */
+static size_t target_cap(uint32_t byte_rate) {
+    size_t cap = (size_t)((uint64_t)byte_rate * sched_need_us / 1000000) +
+                 sched_config.max_read_size;
+    if (cap < sched_config.min_buffer_size) {
+        cap = sched_config.min_buffer_size;
+    }
+    if (cap > sched_config.buffer_size) {
+        cap = sched_config.buffer_size;
+    }
+    return cap;
+}
+
+/**
+ * @brief Move a stream to a buffer of a new size, called with sched_lock held
+ *
+ * The lock is dropped for the allocation, io_busy keeps the stream alive.
+ */
+static void stream_resize(sched_stream_t* stream, size_t cap) {
+    stream->io_busy = true;
+    pthread_mutex_unlock(&sched_lock);
+    uint8_t *buf = stream_alloc(cap);
+    pthread_mutex_lock(&sched_lock);
+    stream->io_busy = false;
+    pthread_cond_broadcast(&stream->cond);
+
+    // The consumer may have drained less than expected meanwhile
+    if (buf == NULL || stream->fill > cap) {
+        free(buf);
+        return;
+    }
+
+    size_t first = stream->cap - stream->rd;
+    if (first > stream->fill) {
+        first = stream->fill;
+    }
+    memcpy(buf, stream->buf + stream->rd, first);
+    memcpy(buf + first, stream->buf, stream->fill - first);
+    free(stream->buf);
+
+    sched_stats.buffer_bytes = sched_stats.buffer_bytes - stream->cap + cap;
+    stream->buf = buf;
+    stream->cap = cap;
+    stream->rd = 0;
+    stream->wr = stream->fill % cap;
+    WAV_TRACE(WAV_TRACE_SCHED_RESIZE, cap);
+}
+
+/**
+ * @brief Record a storage read and periodically retune, called with sched_lock held
+ */
+static void sched_record_latency(int64_t latency_us) {
+    sched_latency_hist[wav_latency_bucket(latency_us)]++;
+    if ((uint64_t)latency_us > sched_stats.latency_max_us) {
+        sched_stats.latency_max_us = latency_us;
+    }
+
+    if (++sched_window_reads < SCHED_ADAPT_WINDOW) {
+        return;
+    }
+    sched_window_reads = 0;
+
+    sched_stats.latency_p50_us = wav_latency_percentile(sched_latency_hist, 50);
+    sched_stats.latency_p99_us = wav_latency_percentile(sched_latency_hist, 99);
+    // Halve old samples so the percentiles follow the current storage behaviour
+    for (int i = 0; i < WAV_PLAYER_LATENCY_BUCKETS; i++) {
+        sched_latency_hist[i] -= sched_latency_hist[i] / 2;
+    }
+
+    // Each stream may wait behind one slow read of every other stream
+    sched_need_us = (uint64_t)sched_stats.latency_p99_us * sched_stats.active_streams *
+                    SCHED_LATENCY_MARGIN;
+    if (!sched_config.adaptive || sched_config.burst) {
+        return;
+    }
+
+    for (sched_stream_t *stream = sched_streams; stream != NULL; stream = stream->next) {
+        size_t target = target_cap(stream->byte_rate);
+        // Grow at once with headroom, shrink only when clearly oversized to avoid churn
+        if (target > stream->cap) {
+            target += target / 2;
+            if (target > sched_config.buffer_size) {
+                target = sched_config.buffer_size;
+            }
+        } else if (target >= stream->cap / 2 || stream->fill > target) {
+            continue;
+        }
+
+        ESP_LOGD(TAG, "Read-ahead %u -> %u bytes (p99 %u us)", (unsigned)stream->cap,
+                 (unsigned)target, (unsigned)sched_stats.latency_p99_us);
+        stream_resize(stream, target);
+    }
+}
+
+static void* sched_io_task(void* arg) {
+    pthread_mutex_lock(&sched_lock);
+    while (sched_running) {
+        size_t size = 0;
+        sched_stream_t *stream = sched_pick_stream(&size);
+        if (stream == NULL) {
+            pthread_cond_wait(&sched_cond, &sched_lock);
+            continue;
+        }
+
+        if (sched_config.burst && !stream->refilling) {
+            stream->refilling = true;
+            sched_stats.bursts++;
+            WAV_TRACE(WAV_TRACE_SCHED_BURST, stream->fill);
+        }
+
+        // The region [wr, wr + size) belongs to the I/O task until io_busy is cleared
+        stream->io_busy = true;
+        uint8_t *dst = stream->buf + stream->wr;
+        pthread_mutex_unlock(&sched_lock);
+
+        WAV_TRACE(WAV_TRACE_SCHED_READ_BEGIN, 0);
+        int64_t start_us = esp_timer_get_time();
+        size_t got = stream->inner->ops->read(stream->inner->ctx, dst, size);
+        int64_t busy_us = esp_timer_get_time() - start_us;
+        WAV_TRACE(WAV_TRACE_SCHED_READ_END, got);
+
+        pthread_mutex_lock(&sched_lock);
+        stream->io_busy = false;
+        stream->wr = (stream->wr + got) % stream->cap;
+        stream->fill += got;
+        if (got == 0) {
+            stream->eof = true;
+            stream->error = wav_source_error(stream->inner);
+        }
+        if (stream->fill == stream->cap || stream->eof) {
+            stream->refilling = false;
+        }
+        sched_stats.reads++;
+        sched_stats.bytes_read += got;
+        sched_stats.io_busy_us += busy_us;
+        pthread_cond_broadcast(&stream->cond);
+        if (got > 0) {
+            sched_record_latency(busy_us);
+        }
+    }
+    pthread_mutex_unlock(&sched_lock);
+    return NULL;
+}
+
+static size_t sched_source_read(void* ctx, void* dst, size_t size) {
+    sched_stream_t *stream = ctx;
+    uint8_t *out = dst;
+
+    pthread_mutex_lock(&sched_lock);
+
+    // Wait for at least one whole frame, or until the block counts as late
+    bool stalled = false;
+    struct timespec deadline;
+    while (stream->fill < stream->block_align && !stream->eof) {
+        if (!stalled) {
+            stalled = true;
+            sched_stats.stalls++;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            uint64_t nsec = deadline.tv_nsec + (uint64_t)sched_config.underrun_timeout_ms * 1000000;
+            deadline.tv_sec += nsec / 1000000000;
+            deadline.tv_nsec = nsec % 1000000000;
+        }
+        pthread_cond_signal(&sched_cond);
+        if (sched_config.underrun_policy == WAV_PLAYER_UNDERRUN_WAIT) {
+            pthread_cond_wait(&stream->cond, &sched_lock);
+        } else if (pthread_cond_timedwait(&stream->cond, &sched_lock, &deadline) != 0 &&
+                   stream->fill < stream->block_align && !stream->eof) {
+            int64_t now = esp_timer_get_time();
+            sched_underrun_log[sched_stats.underruns % WAV_PLAYER_SCHED_UNDERRUN_LOG] = now;
+            sched_stats.underruns++;
+            sched_stats.last_underrun_us = now;
+            stream->underrun = true;
+            pthread_mutex_unlock(&sched_lock);
+            return 0;
+        }
+    }
+
+    size_t n = size < stream->fill ? size : stream->fill;
+    if (!stream->eof) {
+        n -= n % stream->block_align;
+    }
+
+    size_t first = stream->cap - stream->rd;
+    if (first > n) {
+        first = n;
+    }
+    memcpy(out, stream->buf + stream->rd, first);
+    memcpy(out + first, stream->buf, n - first);
+    stream->rd = (stream->rd + n) % stream->cap;
+    stream->fill -= n;
+
+    // Wake the I/O task once this stream needs data
+    if (stream_wants_data(stream)) {
+        pthread_cond_signal(&sched_cond);
+    }
+    pthread_mutex_unlock(&sched_lock);
+
+    return n;
+}
+
+static void sched_source_close(void* ctx) {
+    sched_stream_t *stream = ctx;
+
+    pthread_mutex_lock(&sched_lock);
+    while (stream->io_busy) {
+        pthread_cond_wait(&stream->cond, &sched_lock);
+    }
+    for (sched_stream_t **link = &sched_streams; *link != NULL; link = &(*link)->next) {
+        if (*link == stream) {
+            *link = stream->next;
+            break;
+        }
+    }
+    sched_stats.active_streams--;
+    sched_stats.buffer_bytes -= stream->cap;
+    pthread_mutex_unlock(&sched_lock);
+
+    pthread_cond_destroy(&stream->cond);
+    free(stream->buf);
+    free(stream);
+}
+
+bool wav_sched_take_underrun(const wav_source_t* scheduled, wav_player_underrun_policy_t* policy) {
+    sched_stream_t *stream = scheduled->ctx;
+
+    pthread_mutex_lock(&sched_lock);
+    bool underrun = stream->underrun;
+    stream->underrun = false;
+    *policy = sched_config.underrun_policy;
+    pthread_mutex_unlock(&sched_lock);
+    return underrun;
+}
+
+static esp_err_t sched_source_error(void* ctx) {
+    sched_stream_t *stream = ctx;
+
+    pthread_mutex_lock(&sched_lock);
+    esp_err_t error = stream->error;
+    pthread_mutex_unlock(&sched_lock);
+    return error;
+}
+
+static const wav_source_ops_t sched_source_ops = {
+    .read = sched_source_read,
+    .close = sched_source_close,
+    .error = sched_source_error,
+};
+
+esp_err_t wav_sched_attach(wav_source_t* inner, const wav_header_t* header, wav_source_t* scheduled) {
+    pthread_mutex_lock(&sched_lock);
+    bool available = sched_running && sched_stats.active_streams < sched_config.max_streams;
+    wav_player_sched_config_t cfg = sched_config;
+    size_t target = 0;
+    if (cfg.adaptive && !cfg.burst) {
+        // Until storage has been measured start from the largest buffer
+        target = sched_stats.reads >= SCHED_ADAPT_WINDOW ?
+                 target_cap(header->sample_rate * header->block_align) : cfg.buffer_size;
+    }
+    pthread_mutex_unlock(&sched_lock);
+    if (!available) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    uint32_t byte_rate = header->sample_rate * header->block_align;
+    size_t cap = target ? target : cfg.buffer_size;
+    if (cfg.burst) {
+        cap = (size_t)((uint64_t)byte_rate * cfg.burst_ms / 1000);
+        if (cap < cfg.max_read_size) {
+            cap = cfg.max_read_size;
+        }
+    }
+
+    sched_stream_t *stream = calloc(1, sizeof(*stream));
+    if (stream == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    stream->buf = stream_alloc(cap);
+    if (stream->buf == NULL) {
+        free(stream);
+        return ESP_ERR_NO_MEM;
+    }
+    stream->cap = cap;
+    stream->inner = inner;
+    stream->block_align = header->block_align;
+    stream->byte_rate = byte_rate;
+    pthread_cond_init(&stream->cond, NULL);
+
+    pthread_mutex_lock(&sched_lock);
+    if (!sched_running || sched_stats.active_streams >= sched_config.max_streams) {
+        pthread_mutex_unlock(&sched_lock);
+        pthread_cond_destroy(&stream->cond);
+        free(stream->buf);
+        free(stream);
+        return ESP_ERR_INVALID_STATE;
+    }
+    stream->next = sched_streams;
+    sched_streams = stream;
+    sched_stats.active_streams++;
+    sched_stats.buffer_bytes += stream->cap;
+    pthread_cond_signal(&sched_cond);
+    pthread_mutex_unlock(&sched_lock);
+
+    scheduled->ops = &sched_source_ops;
+    scheduled->ctx = stream;
+    scheduled->block_size = inner->block_size;
+    return ESP_OK;
+}
+
+esp_err_t wav_player_sched_init(const wav_player_sched_config_t* config) {
+    wav_player_sched_config_t cfg = WAV_PLAYER_SCHED_CONFIG_DEFAULT();
+    if (config != NULL) {
+        cfg = *config;
+    }
+    if (cfg.buffer_size == 0 || cfg.max_read_size == 0 || cfg.max_streams == 0 ||
+        cfg.min_read_size > cfg.max_read_size || cfg.max_read_size > cfg.buffer_size ||
+        (cfg.burst && cfg.low_watermark_ms >= cfg.burst_ms) ||
+        (cfg.adaptive && (cfg.min_buffer_size < cfg.max_read_size ||
+                          cfg.min_buffer_size > cfg.buffer_size))) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&sched_lock);
+    if (sched_running) {
+        pthread_mutex_unlock(&sched_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    sched_config = cfg;
+    memset(&sched_stats, 0, sizeof(sched_stats));
+    // Streams ended by a previous deinit may not be closed yet
+    for (sched_stream_t *stream = sched_streams; stream != NULL; stream = stream->next) {
+        sched_stats.active_streams++;
+        sched_stats.buffer_bytes += stream->cap;
+    }
+    memset(sched_latency_hist, 0, sizeof(sched_latency_hist));
+    memset(sched_underrun_log, 0, sizeof(sched_underrun_log));
+    sched_window_reads = 0;
+    sched_need_us = 0;
+    sched_start_us = esp_timer_get_time();
+    sched_running = true;
+    pthread_mutex_unlock(&sched_lock);
+
+    esp_err_t ret = wav_player_thread_create(&sched_task, sched_io_task, NULL, "wav_sched",
+                                             cfg.core_id, SCHED_TASK_STACK_SIZE);
+    if (ret != ESP_OK) {
+        pthread_mutex_lock(&sched_lock);
+        sched_running = false;
+        pthread_mutex_unlock(&sched_lock);
+        return ret;
+    }
+
+    if (cfg.burst) {
+        ESP_LOGI(TAG, "Read scheduler started: %u streams, %u ms bursts",
+                 (unsigned)cfg.max_streams, (unsigned)cfg.burst_ms);
+    } else {
+        ESP_LOGI(TAG, "Read scheduler started: %u streams, %u byte buffers",
+                 (unsigned)cfg.max_streams, (unsigned)cfg.buffer_size);
+    }
+    return ESP_OK;
+}
+
+esp_err_t wav_player_sched_get_stats(wav_player_sched_stats_t* stats) {
+    if (stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&sched_lock);
+    *stats = sched_stats;
+    stats->elapsed_us = sched_start_us ? esp_timer_get_time() - sched_start_us : 0;
+    pthread_mutex_unlock(&sched_lock);
+    return ESP_OK;
+}
+
+esp_err_t wav_player_sched_get_underruns(int64_t* timestamps_us, size_t max, size_t* count) {
+    if (timestamps_us == NULL || count == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&sched_lock);
+    uint32_t total = sched_stats.underruns;
+    size_t n = total < WAV_PLAYER_SCHED_UNDERRUN_LOG ? total : WAV_PLAYER_SCHED_UNDERRUN_LOG;
+    if (n > max) {
+        n = max;
+    }
+    for (size_t i = 0; i < n; i++) {
+        timestamps_us[i] = sched_underrun_log[(total - n + i) % WAV_PLAYER_SCHED_UNDERRUN_LOG];
+    }
+    pthread_mutex_unlock(&sched_lock);
+
+    *count = n;
+    return ESP_OK;
+}
+
+void wav_player_sched_deinit(void) {
+    pthread_mutex_lock(&sched_lock);
+    if (!sched_running) {
+        pthread_mutex_unlock(&sched_lock);
+        return;
+    }
+    sched_running = false;
+    // Attached streams end with what they buffered, their readers must not wait for the I/O task
+    for (sched_stream_t *stream = sched_streams; stream != NULL; stream = stream->next) {
+        if (!stream->eof) {
+            stream->eof = true;
+            stream->error = ESP_ERR_INVALID_STATE;
+        }
+        stream->refilling = false;
+        pthread_cond_broadcast(&stream->cond);
+    }
+    pthread_cond_broadcast(&sched_cond);
+    pthread_mutex_unlock(&sched_lock);
+
+    pthread_join(sched_task, NULL);
+}
@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "wav_player_stats.h"
+#include "wav_player_priv.h"
+
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static wav_player_latency_stats_t stats;
+
+static void hist_add(wav_player_latency_hist_t* hist, uint32_t latency_us) {
+    hist->buckets[wav_latency_bucket(latency_us)]++;
+    hist->count++;
+    hist->total_us += latency_us;
+    if (latency_us > hist->max_us) {
+        hist->max_us = latency_us;
+    }
+}
+
+void wav_stats_record_block(uint32_t read_us, uint32_t convert_us, uint32_t write_us, uint32_t budget_us) {
+    uint32_t total_us = read_us + convert_us + write_us;
+    uint32_t budget_bucket = WAV_PLAYER_BUDGET_BUCKETS - 1;
+    if (budget_us > 0) {
+        uint64_t quarter = (uint64_t)total_us * 4 / budget_us;
+        if (quarter < budget_bucket) {
+            budget_bucket = quarter;
+        }
+    }
+
+    pthread_mutex_lock(&stats_lock);
+    hist_add(&stats.read, read_us);
+    hist_add(&stats.convert, convert_us);
+    hist_add(&stats.write, write_us);
+    stats.budget[budget_bucket]++;
+    stats.blocks++;
+    if (total_us > budget_us) {
+        stats.over_budget++;
+    }
+    if (read_us > budget_us) {
+        stats.read_over_budget++;
+    }
+    pthread_mutex_unlock(&stats_lock);
+}
+
+uint32_t wav_latency_percentile(const uint32_t* buckets, uint32_t percent) {
+    uint64_t total = 0;
+    for (int i = 0; i < WAV_PLAYER_LATENCY_BUCKETS; i++) {
+        total += buckets[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    uint64_t threshold = (total * percent + 99) / 100;
+    uint64_t seen = 0;
+    for (int i = 0; i < WAV_PLAYER_LATENCY_BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen >= threshold) {
+            return 2u << i;
+        }
+    }
+    return 2u << (WAV_PLAYER_LATENCY_BUCKETS - 1);
+}
+
+uint32_t wav_player_latency_percentile(const wav_player_latency_hist_t* hist, uint32_t percent) {
+    if (hist == NULL) {
+        return 0;
+    }
+    return wav_latency_percentile(hist->buckets, percent);
+}
+
+esp_err_t wav_player_get_latency_stats(wav_player_latency_stats_t* out) {
+    if (out == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&stats_lock);
+    *out = stats;
+    pthread_mutex_unlock(&stats_lock);
+    return ESP_OK;
+}
+
+void wav_player_reset_latency_stats(void) {
+    pthread_mutex_lock(&stats_lock);
+    memset(&stats, 0, sizeof(stats));
+    pthread_mutex_unlock(&stats_lock);
+}
+
+/**
+ * @brief snprintf that appends at *len and keeps counting once buf is full
+ */
+#define JSON_APPEND(buf, size, len, ...) \
+    (len) += snprintf((len) < (size) ? (buf) + (len) : NULL, (len) < (size) ? (size) - (len) : 0, __VA_ARGS__)
+
+static size_t hist_to_json(const char* name, const wav_player_latency_hist_t* hist,
+                           char* buf, size_t size, size_t len) {
+    JSON_APPEND(buf, size, len, "\"%s\":{\"count\":%u,\"total_us\":%llu,\"max_us\":%u,\"buckets\":[",
+                name, (unsigned)hist->count, (unsigned long long)hist->total_us, (unsigned)hist->max_us);
+    for (int i = 0; i < WAV_PLAYER_LATENCY_BUCKETS; i++) {
+        JSON_APPEND(buf, size, len, i ? ",%u" : "%u", (unsigned)hist->buckets[i]);
+    }
+    JSON_APPEND(buf, size, len, "]},");
+    return len;
+}
+
+size_t wav_player_latency_stats_to_json(const wav_player_latency_stats_t* s, char* buf, size_t size) {
+    if (s == NULL || (buf == NULL && size > 0)) {
+        return 0;
+    }
+
+    size_t len = 0;
+    JSON_APPEND(buf, size, len, "{");
+    len = hist_to_json("read", &s->read, buf, size, len);
+    len = hist_to_json("convert", &s->convert, buf, size, len);
+    len = hist_to_json("write", &s->write, buf, size, len);
+    JSON_APPEND(buf, size, len, "\"budget\":[");
+    for (int i = 0; i < WAV_PLAYER_BUDGET_BUCKETS; i++) {
+        JSON_APPEND(buf, size, len, i ? ",%u" : "%u", (unsigned)s->budget[i]);
+    }
+    JSON_APPEND(buf, size, len, "],\"blocks\":%u,\"over_budget\":%u,\"read_over_budget\":%u}",
+                (unsigned)s->blocks, (unsigned)s->over_budget, (unsigned)s->read_over_budget);
+    return len;
+}
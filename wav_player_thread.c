@@ -0,0 +1,61 @@
+#include <pthread.h>
+#include <unistd.h>
+#include "sdkconfig.h"
+#include "wav_player_priv.h"
+#include "esp_log.h"
+
+#if !CONFIG_IDF_TARGET_LINUX
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_pthread.h"
+#endif
+
+static const char *TAG = "wav_player_thread";
+
+esp_err_t wav_player_thread_create(pthread_t* thread, void* (*fn)(void*), void* arg,
+                                   const char* name, int core_id, size_t stack_size) {
+#if CONFIG_IDF_TARGET_LINUX
+    (void)name;
+    (void)core_id;
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, stack_size < PTHREAD_STACK_MIN ? PTHREAD_STACK_MIN : stack_size);
+    int err = pthread_create(thread, &attr, fn, arg);
+    pthread_attr_destroy(&attr);
+#else
+    // esp_pthread configuration is per calling task, restore it afterwards
+    esp_pthread_cfg_t saved;
+    bool has_saved = esp_pthread_get_cfg(&saved) == ESP_OK;
+
+    esp_pthread_cfg_t cfg = esp_pthread_get_default_config();
+    cfg.stack_size = stack_size;
+    cfg.thread_name = name;
+    cfg.pin_to_core = core_id == WAV_PLAYER_CORE_ANY ? tskNO_AFFINITY : core_id;
+    esp_pthread_set_cfg(&cfg);
+
+    int err = pthread_create(thread, NULL, fn, arg);
+
+    if (has_saved) {
+        esp_pthread_set_cfg(&saved);
+    } else {
+        cfg = esp_pthread_get_default_config();
+        esp_pthread_set_cfg(&cfg);
+    }
+#endif
+
+    if (err != 0) {
+        ESP_LOGE(TAG, "Failed to create thread %s (%d)", name, err);
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+size_t wav_player_num_cores(void) {
+#if CONFIG_IDF_TARGET_LINUX
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores > 0 ? (size_t)cores : 1;
+#else
+    return portNUM_PROCESSORS;
+#endif
+}
@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "wav_player_trace_priv.h"
+#include "wav_player_priv.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#if CONFIG_WAV_PLAYER_TRACE
+
+static const char *TAG = "wav_player_trace";
+
+#define TRACE_VERSION 1
+#define TRACE_HEADER_SIZE 16
+
+static wav_player_trace_record_t trace_ring[CONFIG_WAV_PLAYER_TRACE_EVENTS];
+static atomic_uint_fast32_t trace_next;     // total events recorded, slot = next % size
+static atomic_uint_fast16_t trace_tasks;
+static __thread uint16_t trace_task_id;     // 0 until the task records its first event
+
+void wav_trace_record(wav_player_trace_event_t event, uint32_t arg) {
+    if (trace_task_id == 0) {
+        trace_task_id = atomic_fetch_add(&trace_tasks, 1) + 1;
+    }
+
+    uint32_t n = atomic_fetch_add(&trace_next, 1);
+    wav_player_trace_record_t *rec = &trace_ring[n % CONFIG_WAV_PLAYER_TRACE_EVENTS];
+    rec->time_us = esp_timer_get_time();
+    rec->arg = arg;
+    rec->event = event;
+    rec->task = trace_task_id;
+}
+
+size_t wav_player_trace_read(wav_player_trace_record_t* records, size_t max) {
+    if (records == NULL) {
+        return 0;
+    }
+
+    uint32_t total = atomic_load(&trace_next);
+    size_t n = total < CONFIG_WAV_PLAYER_TRACE_EVENTS ? total : CONFIG_WAV_PLAYER_TRACE_EVENTS;
+    if (n > max) {
+        n = max;
+    }
+    for (size_t i = 0; i < n; i++) {
+        records[i] = trace_ring[(total - n + i) % CONFIG_WAV_PLAYER_TRACE_EVENTS];
+    }
+    return n;
+}
+
+esp_err_t wav_player_trace_save(const char* filepath) {
+    if (filepath == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    wav_player_trace_record_t *records = malloc(sizeof(trace_ring));
+    if (records == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    size_t count = wav_player_trace_read(records, CONFIG_WAV_PLAYER_TRACE_EVENTS);
+
+    uint8_t header[TRACE_HEADER_SIZE] = {
+        'W', 'T', 'R', 'C',
+        TRACE_VERSION, 0, 0, 0,
+        count & 0xFF, (count >> 8) & 0xFF, (count >> 16) & 0xFF, count >> 24,
+        sizeof(wav_player_trace_record_t), 0, 0, 0,
+    };
+
+    esp_err_t ret = ESP_OK;
+    FILE *fp = fopen(filepath, "wb");
+    if (fp == NULL || fwrite(header, 1, sizeof(header), fp) != sizeof(header) ||
+        fwrite(records, sizeof(*records), count, fp) != count) {
+        ESP_LOGE(TAG, "Failed to write %s", filepath);
+        ret = ESP_FAIL;
+    }
+    if (fp != NULL && fclose(fp) != 0) {
+        ret = ESP_FAIL;
+    }
+    free(records);
+
+    if (ret == ESP_OK) {
+        ESP_LOGI(TAG, "Saved %u trace events to %s", (unsigned)count, filepath);
+    }
+    return ret;
+}
+
+void wav_player_trace_clear(void) {
+    atomic_store(&trace_next, 0);
+}
+
+#else
+
+size_t wav_player_trace_read(wav_player_trace_record_t* records, size_t max) {
+    return 0;
+}
+
+esp_err_t wav_player_trace_save(const char* filepath) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void wav_player_trace_clear(void) {
+}
+
+#endif